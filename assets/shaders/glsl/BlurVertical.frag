@@ -0,0 +1,15 @@
+#version 450
+
+layout(binding = 0) uniform sampler2D source;
+
+layout(location = 0) in vec2 frag_tex_coord;
+
+layout(location = 0) out vec4 out_colour;
+
+const vec2 direction = vec2(0.0, 1.0);
+
+void main() {
+    // Half a texel either side, so linear filtering weights the three nearest texels 1:2:1
+    vec2 offset = direction * 0.5 / vec2(textureSize(source, 0));
+    out_colour = 0.5 * (texture(source, frag_tex_coord - offset) + texture(source, frag_tex_coord + offset));
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 450
+
+layout(binding = 0) uniform sampler2D source;
+
+layout(location = 0) in vec2 frag_tex_coord;
+
+layout(location = 0) out vec4 out_colour;
+
+void main() {
+    out_colour = texture(source, frag_tex_coord);
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#version 450
+
+layout(location = 0) out vec2 frag_tex_coord;
+
+// A single triangle covering the screen, with texture coordinates running 0 to 1 across it
+void main() {
+    frag_tex_coord = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(frag_tex_coord * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Counts global operator new calls while enabled, attributing each to the innermost AllocationSite
+ * active on the calling thread. Used by the allocation test mode to check the frame loop doesn't
+ * touch the heap once it's warmed up.
+ *
+ * Replacing operator new costs every allocation, so it's only compiled in with ALLOCATION_TEST defined,
+ * which the AllocationTest configuration does. Otherwise nothing is counted and AllocationSite is empty
+ */
+namespace AllocationTracker {
+#ifdef ALLOCATION_TEST
+	constexpr bool available = true;
+#else
+	constexpr bool available = false;
+#endif
+
+	struct SiteCount {
+		std::string site;
+		uint64_t allocations;
+		uint64_t bytes;
+	};
+
+	struct Report {
+		uint64_t allocations = 0;
+		uint64_t bytes = 0;
+		std::vector<SiteCount> sites;
+	};
+
+	void start();
+	Report stop();
+	bool is_enabled();
+
+	void record_allocation(size_t size);
+}
+
+/**
+ * Names the code allocating on this thread until it goes out of scope. The name must be a string literal
+ */
+#ifdef ALLOCATION_TEST
+class AllocationSite {
+public:
+	explicit AllocationSite(const char* name);
+	AllocationSite(const AllocationSite&) = delete;
+	~AllocationSite();
+
+	static const char* current();
+
+private:
+	const char* previous;
+};
+#else
+class AllocationSite {
+public:
+	explicit AllocationSite(const char*) {}
+	AllocationSite(const AllocationSite&) = delete;
+
+	static const char* current() { return nullptr; }
+};
+#endif
@@ -15,12 +15,17 @@
 #include "Framebuffer.h"
 #include "CommandBuffer.h"
 #include "CommandPool.h"
+#include "UploadManager.h"
+#include "SubmitBatch.h"
+#include "Defragmenter.h"
 
 class Application {
 public:
 	static std::string name;
 	static Version version;
 
+    static constexpr VkDeviceSize upload_bytes_per_frame = 8ull * 1024 * 1024;
+
     Application(Instance& instance, Device& device, Window& window, Surface& surface, Settings& settings);
     virtual ~Application();
 
@@ -38,5 +43,10 @@ protected:
 
     std::unique_ptr<SwapChain> swap_chain;
     std::unique_ptr<CommandPool> command_pool;
+    std::unique_ptr<CommandPool> transfer_command_pool;
+    std::unique_ptr<UploadManager> upload_manager;
+    // Everything for the graphics queue this frame, sent in one submit at the end of it
+    SubmitBatch frame_submits;
+    std::unique_ptr<Defragmenter> defragmenter;
 };
 
@@ -11,5 +11,10 @@ public:
 	std::optional<VkAttachmentReference> depth_attachment_reference;
 
 	void add_attachment(VkFormat format, bool store = true);
+	void add_transient_attachment(VkFormat format);
+	void add_attachment(VkFormat format, VkAttachmentLoadOp load_op, VkAttachmentStoreOp store_op, VkImageLayout initial_layout, VkImageLayout final_layout);
+
+private:
+	void add_attachment(VkFormat format, VkAttachmentStoreOp store_op, bool transient);
 };
 
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+#include "Image.h"
+#include "Buffer.h"
+
+/**
+ * Collects memory, buffer and image barriers so they're recorded as a single vkCmdPipelineBarrier.
+ * Image barriers are worked out from the image's tracked state, using only the stages and accesses
+ * that actually need waiting on. The vectors are kept between flushes so recording doesn't allocate
+ */
+class BarrierBatch {
+public:
+	void add_image(Image& image, const ImageState& state, bool discard, uint32_t base_mip_level, uint32_t mip_level_count, uint32_t base_array_layer, uint32_t array_layer_count);
+	void add_buffer(const Buffer& buffer, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void add_memory(VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access);
+	void add_buffer_ownership(const Buffer& buffer, uint32_t src_family, uint32_t dest_family, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access);
+	void add_image_release(Image& image, VkImageLayout new_layout, uint32_t src_family, uint32_t dest_family);
+	void add_image_acquire(Image& image, VkImageLayout old_layout, const ImageState& state, uint32_t src_family, uint32_t dest_family);
+
+	bool empty() const;
+	void flush(VkCommandBuffer command_buffer);
+	void clear();
+
+private:
+	VkPipelineStageFlags src_stages = 0;
+	VkPipelineStageFlags dest_stages = 0;
+	std::vector<VkMemoryBarrier> memory_barriers;
+	std::vector<VkBufferMemoryBarrier> buffer_barriers;
+	std::vector<VkImageMemoryBarrier> image_barriers;
+};
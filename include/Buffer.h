@@ -6,12 +6,15 @@
 #include <memory>
 
 #include "Device.h"
+#include "MemoryAllocator.h"
+#include "Defragmentable.h"
 #include "Type.h"
+#include "ResourcePool.h"
 #include "Logger.h"
 
 using namespace std::literals::string_view_literals;
 
-class Buffer {
+class Buffer : public Defragmentable {
 public:
 	template <class T>
 	static std::unique_ptr<Buffer> create_buffer(Device &device, const std::vector<T>& data, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation = LocalMemory::Dynamic) {
@@ -23,12 +26,13 @@ public:
 		// Need new here as we've got a private constructor
 		Buffer *buffer = new Buffer(device, buffer_size, buffer_usage, memory_properties, local_memory_allocation);
 		buffer->fill_buffer(static_cast<const void*>(data.data()), buffer_size);
+		buffer->flush();
 
 		return std::unique_ptr<Buffer>(buffer);
 	}
 
-	static std::unique_ptr<Buffer> create_empty_buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation = LocalMemory::Dynamic) {
-		Buffer *buffer = new Buffer(device, buffer_size, buffer_usage, memory_properties, local_memory_allocation);
+	static std::unique_ptr<Buffer> create_empty_buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation = LocalMemory::Dynamic, VkMemoryPropertyFlags preferred_properties = 0) {
+		Buffer *buffer = new Buffer(device, buffer_size, buffer_usage, memory_properties, local_memory_allocation, preferred_properties);
 		return std::unique_ptr<Buffer>(buffer);
 	}
 
@@ -47,27 +51,60 @@ public:
 		
 		Buffer* buffer = new Buffer(device, image_size, buffer_usage, memory_properties, local_memory_allocation);
 		buffer->fill_buffer(static_cast<const void*>(image_data), image_size);
+		buffer->flush();
 		stbi_image_free(image_data);
 
 		return std::make_tuple(std::unique_ptr<Buffer>(buffer), tex_width, tex_height);
 	}
 
+	static VkMemoryRequirements query_memory_requirements(Device& device, VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage);
+
 	~Buffer();
 
 	const VkBuffer& get() const;
+	VkDeviceSize get_size() const;
 
 	void fill_buffer(const void* data, VkDeviceSize data_size, uint32_t offset = 0);
+	void read_buffer(void* data, VkDeviceSize data_size, uint32_t offset = 0);
+
+	void flush();
+	void invalidate(VkDeviceSize data_size = VK_WHOLE_SIZE, uint32_t offset = 0);
+
+	bool is_coherent() const;
+	const void* get_mapped_memory() const;
+
+	const Allocation& get_allocation() const override;
+	void record_move(CommandBuffer& command_buffer, const Allocation& new_allocation) override;
+	std::unique_ptr<Defragmentable> finish_move() override;
+	void cancel_move() override;
 
 private:
+	// Pools construct buffers in place
+	template <class> friend class ResourcePool;
+
 	Buffer(const Buffer&) = delete;
 	Buffer& operator=(Buffer const&) = delete;
-	Buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation);
+	Buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation, VkMemoryPropertyFlags preferred_properties = 0);
+	Buffer(const Buffer& source, const Allocation& allocation);
+
+	static MemoryCategory get_memory_category(VkBufferUsageFlags buffer_usage);
+
+	void create_handle(VkBufferUsageFlags buffer_usage);
 
 	Device &device;
 	VkBuffer buffer;
 	uint32_t buffer_size;
+	VkBufferUsageFlags buffer_usage;
 	VkMemoryRequirements memory_requirements;
-	VkDeviceMemory device_memory;
+	Allocation allocation;
 	std::optional<void*> mapped_memory;
+	bool coherent;
+
+	// Device local buffers which aren't mapped can be moved by the defragmenter
+	bool movable = false;
+	std::unique_ptr<Buffer> moved_buffer;
+
+	// Written ranges of a persistently mapped, non-coherent buffer which still need flushing
+	std::vector<std::pair<VkDeviceSize, VkDeviceSize>> dirty_ranges;
 };
 
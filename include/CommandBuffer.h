@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <initializer_list>
+#include <span>
 
 #include "Device.h"
 #include "RenderPass.h"
@@ -10,33 +12,49 @@
 #include "DescriptorPool.h"
 #include "Image.h"
 #include "Type.h"
+#include "BarrierBatch.h"
 
 class CommandPool;
 
 class CommandBuffer {
 public:
-	CommandBuffer(Device &device, CommandPool &command_pool);
+	CommandBuffer(Device &device, CommandPool &command_pool, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	CommandBuffer(const CommandBuffer&) = delete;
 	~CommandBuffer();
 
 	VkCommandBuffer get();
+	uint32_t get_queue_family_index() const;
 
 	void start_recording(bool one_time = false);
-	void cmd_begin_render_pass(RenderPass& render_pass, Framebuffer &framebuffer, AttachmentDescriptions& attachment_descriptions);
+	void start_recording(const CommandBuffer& primary);
+	void cmd_begin_render_pass(RenderPass& render_pass, Framebuffer &framebuffer, AttachmentDescriptions& attachment_descriptions, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 	void cmd_bind_pipeline(Pipeline &pipeline);
-	void cmd_bind_vertex_buffer(Buffer &buffer);
-	void cmd_bind_index_buffer(Buffer& buffer, VkIndexType index_type);
-	void cmd_bind_descriptor_set(DescriptorPool& descriptor_pool, Pipeline& pipeline, uint32_t descriptor_index);
+	void cmd_bind_vertex_buffer(Buffer &buffer, VkDeviceSize offset = 0);
+	void cmd_bind_index_buffer(Buffer& buffer, VkIndexType index_type, VkDeviceSize offset = 0);
+	void cmd_bind_descriptor_set(DescriptorPool& descriptor_pool, Pipeline& pipeline, uint32_t descriptor_index, std::initializer_list<uint32_t> dynamic_offsets = {});
 	void cmd_set_viewport();
 	void cmd_set_viewport(VkViewport viewport);
 	void cmd_set_scissor();
 	void cmd_set_scissor(VkRect2D scissor);
 	void cmd_draw(size_t indices);
 	void cmd_draw_indexed(size_t indices);
+	void cmd_dispatch(uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+	void cmd_dispatch_indirect(Buffer& buffer, VkDeviceSize offset = 0);
 	void cmd_end_render_pass();
-	void cmd_copy_buffer(Buffer& src_buffer, Buffer& dest_buffer, size_t data_size);
-	void cmd_image_pipeline_barrier(const Image& image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-	void cmd_copy_buffer_to_image(const Buffer& buffer, const Image& image, uint32_t width, uint32_t height);
+	void cmd_execute_commands(std::span<CommandBuffer* const> secondary_command_buffers);
+	void cmd_copy_buffer(Buffer& src_buffer, Buffer& dest_buffer, size_t data_size, VkDeviceSize src_offset = 0, VkDeviceSize dest_offset = 0);
+	void cmd_transition_image(Image& image, VkImageLayout new_layout, bool discard = false);
+	void cmd_transition_image(Image& image, const ImageState& new_state, bool discard = false);
+	void cmd_transition_subresource(Image& image, const ImageState& new_state, uint32_t mip_level, uint32_t array_layer, bool discard = false);
+	void cmd_buffer_barrier(const Buffer& buffer, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+	void cmd_release_buffer(const Buffer& buffer, uint32_t dest_family, VkPipelineStageFlags src_stage, VkAccessFlags src_access);
+	void cmd_acquire_buffer(const Buffer& buffer, uint32_t src_family, VkPipelineStageFlags dest_stage, VkAccessFlags dest_access);
+	void cmd_release_image(Image& image, uint32_t dest_family, VkImageLayout new_layout);
+	void cmd_acquire_image(Image& image, uint32_t src_family, VkImageLayout old_layout, const ImageState& new_state);
+	void cmd_flush_barriers();
+	void cmd_copy_image(const Image& src_image, const Image& dest_image, uint32_t width, uint32_t height);
+	void cmd_memory_barrier(VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access);
+	void cmd_copy_buffer_to_image(const Buffer& buffer, const Image& image, uint32_t width, uint32_t height, VkDeviceSize buffer_offset = 0);
 	void stop_recording();
 
 	void reset();
@@ -45,6 +63,16 @@ private:
 	Device &device;
 	CommandPool &command_pool;
 	VkCommandBuffer command_buffer;
+	const VkCommandBufferLevel level;
 	std::optional<Framebuffer *> framebuffer;
+	// The render pass being recorded, which secondary command buffers continue
+	RenderPass* render_pass = nullptr;
+	uint32_t subpass = 0;
+	// Set while in a render pass begun with SECONDARY_COMMAND_BUFFERS contents, where only cmd_execute_commands may record
+	bool secondary_contents = false;
+	// Barriers are held back until the next command which needs them
+	BarrierBatch barriers;
+
+	void check_inline(const char* command) const;
 };
 
@@ -5,19 +5,33 @@
 #include "Device.h"
 #include "CommandBuffer.h"
 
+/**
+ * Long-lived command buffers come from create_command_buffer() and are reset one at a time, which needs
+ * RESET_COMMAND_BUFFER. Per-frame recording should instead use a TRANSIENT pool per frame in flight, taking
+ * buffers with next_command_buffer() and resetting the whole pool with reset() once the frame has finished
+ */
 class CommandPool : public std::enable_shared_from_this<CommandPool> {
 public:
 	std::vector<std::unique_ptr<CommandBuffer>> command_buffers;
 
-	CommandPool(Device &device);
+	CommandPool(Device &device, QueueType queue_type = GRAPHICS, VkCommandPoolCreateFlags flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	~CommandPool();
 
 	VkCommandPool get();
+	uint32_t get_queue_family_index() const;
 
-	CommandBuffer &create_command_buffer();
+	CommandBuffer &create_command_buffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	CommandBuffer &next_command_buffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	void reset();
 
 private:
 	Device &device;
 	VkCommandPool command_pool;
+	// Command buffers from this pool can only be submitted to queues of this family
+	uint32_t queue_family_index;
+	std::vector<std::unique_ptr<CommandBuffer>> secondary_command_buffers;
+	// Buffers before these have been handed out by next_command_buffer since the last reset
+	size_t next_free = 0;
+	size_t next_free_secondary = 0;
 };
 
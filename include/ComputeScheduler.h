@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <span>
+#include <optional>
+
+#include "Device.h"
+#include "Queue.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+
+/**
+ * Runs a frame's compute work (culling, simulation, post-processing) on the compute queue, so it overlaps the
+ * graphics queue. Each frame's work is recorded between begin() and submit(). The graphics submit then waits on
+ * the TimelineWait submit() returns, and records acquire() before using anything compute handed over.
+ *
+ * acquire() is recorded even when nothing changes owner, as the next submit() waits on the graphics work it went
+ * out with. Compute can then never overwrite results graphics is still reading, so that graphics work has to be
+ * submitted before the next submit().
+ *
+ * Where the compute queue is in a different family, resources written by compute are released to the graphics
+ * family and acquired there. Where compute and graphics share a queue the work is submitted to it in order, and
+ * releases become plain barriers
+ */
+class ComputeScheduler {
+public:
+	ComputeScheduler(Device& device, uint32_t frames_in_flight);
+	ComputeScheduler(const ComputeScheduler&) = delete;
+	~ComputeScheduler();
+
+	CommandBuffer& begin(uint32_t frame);
+	void release_buffer(const Buffer& buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dest_stage, VkAccessFlags dest_access);
+	void release_image(Image& image, const ImageState& state);
+	TimelineWait submit(VkPipelineStageFlags dest_stage, std::span<const TimelineWait> timeline_waits = {});
+	void acquire(CommandBuffer& graphics_command_buffer);
+
+	bool is_async() const;
+	bool transfers_ownership() const;
+	Queue& get_queue();
+
+private:
+	struct Frame {
+		// Transient, and reset as a whole once the frame's last submit has finished
+		std::unique_ptr<CommandPool> command_pool;
+		CommandBuffer* command_buffer = nullptr;
+		// Compute timeline value of the frame's last submit
+		uint64_t timeline_value = 0;
+	};
+
+	struct BufferHandoff {
+		const Buffer* buffer;
+		VkPipelineStageFlags dest_stage;
+		VkAccessFlags dest_access;
+	};
+
+	struct ImageHandoff {
+		Image* image;
+		VkImageLayout old_layout;
+		ImageState state;
+	};
+
+	Device& device;
+	Queue& compute_queue;
+	Queue& graphics_queue;
+	std::vector<Frame> frames;
+	Frame* recording = nullptr;
+
+	// Released by the last submit and waiting to be acquired on graphics. Kept between frames so they don't allocate
+	std::vector<BufferHandoff> buffer_handoffs;
+	std::vector<ImageHandoff> image_handoffs;
+
+	// Graphics timeline value from before the last acquire(), so any later value includes the graphics work it went out with
+	std::optional<uint64_t> acquired_after;
+	// Graphics timeline value every submit waits on, covering the graphics work which read the last results
+	uint64_t graphics_value = 0;
+	std::vector<TimelineWait> timeline_waits;
+};
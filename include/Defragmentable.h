@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+
+#include "MemoryAllocator.h"
+
+class CommandBuffer;
+
+/**
+ * A resource the Defragmenter is allowed to move. Vulkan resources can't be rebound, so a move creates
+ * a copy of the resource in the new allocation, then swaps the copy's handles in once the GPU copy is done
+ */
+class Defragmentable {
+public:
+	virtual ~Defragmentable() = default;
+
+	virtual const Allocation& get_allocation() const = 0;
+
+	/**
+	 * Creates the copy bound to new_allocation and records copying the contents across
+	 */
+	virtual void record_move(CommandBuffer& command_buffer, const Allocation& new_allocation) = 0;
+
+	/**
+	 * Starts using the copy. Returns a resource holding the old handles
+	 */
+	virtual std::unique_ptr<Defragmentable> finish_move() = 0;
+
+	/**
+	 * Throws away the copy. Only call once the copy commands have finished
+	 */
+	virtual void cancel_move() = 0;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+
+#include "Device.h"
+#include "Defragmentable.h"
+#include "UploadManager.h"
+
+class CommandPool;
+class CommandBuffer;
+class Queue;
+class SubmitBatch;
+
+/**
+ * Packs long-lived resources out of sparsely used memory blocks so the allocator can release them.
+ * Each update moves at most bytes_per_frame with GPU copies, added to the frame's submit batch, then swaps the moved resources over once
+ * the queue's timeline passes the copy. Old handles go on the device's deletion queue until no frame uses them.
+ * A resource written while its copy is in flight keeps its old allocation, while the rest of the batch still moves
+ */
+class Defragmenter {
+public:
+	static constexpr VkDeviceSize default_bytes_per_frame = 4ull * 1024 * 1024;
+
+	Defragmenter(Device& device, CommandPool& command_pool, Queue& queue, SubmitBatch& submits, UploadManager& upload_manager, VkDeviceSize bytes_per_frame = default_bytes_per_frame);
+	Defragmenter(const Defragmenter&) = delete;
+	~Defragmenter();
+
+	void update();
+	void cancel(Defragmentable* resource);
+	void invalidate(Defragmentable* resource);
+
+	const VkDeviceSize bytes_per_frame;
+
+private:
+	// Timeline values start at 1, so this marks a batch which hasn't been submitted yet
+	static constexpr uint64_t queued = 0;
+
+	Device& device;
+	Queue& queue;
+	SubmitBatch& submits;
+	UploadManager& upload_manager;
+
+	CommandBuffer& command_buffer;
+	bool batch_in_flight = false;
+	// Timeline value of the batch in flight. The frame's submit writes it through a pointer, so it must stay put
+	uint64_t batch_value = queued;
+	std::vector<Defragmentable*> moves;
+	// Written since their copy was recorded, so they're cancelled rather than finished
+	std::vector<Defragmentable*> stale_moves;
+
+	void start_batch();
+	void submit_queued();
+	void finish_batch();
+	void cancel_batch();
+};
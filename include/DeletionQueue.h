@@ -0,0 +1,40 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+class Device;
+class Queue;
+
+/**
+ * Owned by the Device. Resources push the Vulkan calls which destroy them here instead of making them
+ * straight away, tagged with the timeline value of the last submit on every queue. Once every queue's
+ * timeline has passed those values nothing can still be using the resource, and it's destroyed.
+ * Entries are kept in the order they were pushed, as that's the order their tags complete in
+ */
+class DeletionQueue {
+public:
+	DeletionQueue(Device& device);
+	DeletionQueue(const DeletionQueue&) = delete;
+	~DeletionQueue();
+
+	void push(std::function<void()> destroy);
+
+	void release();
+	void flush();
+
+private:
+	struct Entry {
+		std::vector<uint64_t> submitted_values;
+		std::function<void()> destroy;
+	};
+
+	// Every queue on the device, including those only worker threads submit to
+	std::vector<Queue*> queues;
+	std::vector<uint64_t> completed_values;
+	std::deque<Entry> entries;
+
+	bool is_complete(const Entry& entry) const;
+};
@@ -6,12 +6,16 @@
 
 #include "Device.h"
 #include "Buffer.h"
+#include "Image.h"
 #include "DescriptorSetInfo.h"
 
 class DescriptorPool {
 public:
+	/**
+	 * Holds the image rather than its view, as the defragmenter may replace the view
+	 */
 	struct ImageSampler {
-		VkImageView image_view;
+		const Image* image;
 		VkSampler sampler;
 	};
 
@@ -24,7 +28,8 @@ public:
 
 	void allocate_descriptor_set(VkDescriptorSetLayout descriptor_set_layout);
 	void update_descriptor_sets(std::vector<DescriptorAccess>& data);
-
+	void replace_descriptor_accesses(std::vector<DescriptorAccess>& data);
+	void refresh_descriptor_set(uint32_t index);
 
 private:
 	Device& device;
@@ -33,5 +38,10 @@ private:
 	std::vector<DescriptorSetInfo> descriptor_set_infos;
 	std::vector<VkDescriptorSet> descriptor_sets;
 	uint32_t descriptor_count;
+
+	std::vector<DescriptorAccess> descriptor_accesses;
+	std::vector<uint64_t> written_generations;
+
+	void write_descriptor_set(uint32_t index);
 };
 
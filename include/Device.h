@@ -6,11 +6,19 @@
 #include <iterator>
 #include <stdexcept>
 #include <set>
+#include <memory>
+#include <vector>
+#include <map>
 
 #include "PhysicalDevice.h"
 class Settings;
 class QueueFamily;
 class Queue;
+class MemoryAllocator;
+struct ResourcePools;
+class DeletionQueue;
+class SyncPool;
+class UploadManager;
 enum QueueType;
 
 class Device {
@@ -26,11 +34,31 @@ public:
 	VkDevice get() const;
 
 	void wait_idle();
+	bool has_extension(const std::string& extension) const;
+
+	MemoryAllocator& get_allocator() const;
+	ResourcePools& get_resources() const;
+	DeletionQueue& get_deletion_queue() const;
+	SyncPool& get_sync_pool() const;
+	UploadManager* get_upload_manager() const;
+	void set_upload_manager(UploadManager* upload_manager);
+
+	Queue& get_queue(QueueType queue_type, uint32_t index) const;
+	uint32_t get_queue_count(QueueType queue_type) const;
 
 	PhysicalDevice physical_device;
+	// The queue each type uses by default
 	std::map<QueueType, std::shared_ptr<Queue>> queues;
+	// Every queue created, by family index
+	std::map<uint32_t, std::vector<std::shared_ptr<Queue>>> family_queues;
 
 private:
 	VkDevice device;
+	std::set<std::string> enabled_extensions;
+	std::unique_ptr<MemoryAllocator> allocator;
+	std::unique_ptr<ResourcePools> resources;
+	std::unique_ptr<DeletionQueue> deletion_queue;
+	std::unique_ptr<SyncPool> sync_pool;
+	UploadManager* upload_manager = nullptr;
 };
 
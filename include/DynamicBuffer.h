@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+
+#include "Device.h"
+#include "Buffer.h"
+
+/**
+ * Persistently mapped geometry buffer for data written by the CPU every frame, such as particles, UI or
+ * debug lines. Each frame in flight has its own buffer, so writing one frame never races the GPU reading
+ * another. Writes are bump-allocated and return the offset to bind. When a frame overflows its buffer,
+ * the buffer grows geometrically and the other frames grow to match when they next begin
+ */
+class DynamicBuffer {
+public:
+	static constexpr VkDeviceSize default_alignment = 4;
+	static constexpr VkDeviceSize growth_factor = 2;
+
+	DynamicBuffer(Device& device, VkBufferUsageFlags buffer_usage, VkDeviceSize initial_size, uint32_t frames);
+	DynamicBuffer(const DynamicBuffer&) = delete;
+
+	void begin_frame(uint32_t frame);
+	VkDeviceSize allocate(VkDeviceSize size, VkDeviceSize alignment = default_alignment);
+	VkDeviceSize push(const void* data, VkDeviceSize size, VkDeviceSize alignment = default_alignment);
+
+	template <class T>
+	VkDeviceSize push(const std::vector<T>& data, VkDeviceSize alignment = default_alignment) {
+		return push(static_cast<const void*>(data.data()), sizeof(T) * data.size(), alignment);
+	}
+
+	void flush();
+
+	Buffer& get_buffer();
+	VkDeviceSize get_capacity() const;
+	VkDeviceSize get_used() const;
+
+	const VkBufferUsageFlags buffer_usage;
+
+private:
+	Device& device;
+	std::vector<std::unique_ptr<Buffer>> buffers;
+	VkDeviceSize capacity;
+	uint32_t current_frame = 0;
+	VkDeviceSize head = 0;
+
+	std::unique_ptr<Buffer> create_frame_buffer(VkDeviceSize size);
+	void grow(VkDeviceSize required_size);
+};
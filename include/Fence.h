@@ -4,13 +4,14 @@
 
 class Fence {
 public:
-	Fence(Device& device);
+	Fence(Device& device, bool signalled = true);
 	~Fence();
 
 	VkFence get();
 
 	void wait(uint64_t timeout = UINT64_MAX);
 	void reset();
+	bool is_signalled();
 
 	static void wait_all(std::vector<Fence> &fences, uint64_t timeout = UINT64_MAX);
 	static void wait_any(std::vector<Fence>& fences, uint64_t timeout = UINT64_MAX);
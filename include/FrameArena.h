@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Linear allocator for data which only lives for a frame, such as the arrays built to submit or present.
+ * Each frame in flight has its own region, which is reset by begin_frame once that frame's fence has
+ * signalled. Allocations are a pointer bump and frees do nothing. If a region fills up, allocations
+ * fall back to the heap until it's next reset. Only use it from the thread running the frame loop
+ */
+class FrameArena {
+public:
+	static constexpr size_t default_region_size = 64 * 1024;
+
+	static FrameArena& get();
+
+	FrameArena(const FrameArena&) = delete;
+	~FrameArena();
+
+	void begin_frame(uint32_t frame);
+	void* allocate(size_t size, size_t alignment);
+	void deallocate(void* memory);
+
+	uint64_t get_overflow_count() const;
+
+private:
+	struct Region {
+		char* memory;
+		size_t head;
+	};
+
+	std::vector<Region> regions;
+	uint32_t current_region = 0;
+	uint64_t overflow_count = 0;
+
+	FrameArena();
+
+	bool owns(const void* memory) const;
+};
+
+/**
+ * Standard allocator over the FrameArena, so containers built on the per-frame path don't touch the heap
+ */
+template <class T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	ArenaAllocator() noexcept = default;
+
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U>&) noexcept {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(FrameArena::get().allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* memory, size_t) noexcept {
+		FrameArena::get().deallocate(memory);
+	}
+
+	template <class U>
+	bool operator==(const ArenaAllocator<U>&) const noexcept {
+		return true;
+	}
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -8,6 +8,7 @@
 class Framebuffer {
 public:
 	Framebuffer(Device &device, RenderPass& render_pass, std::vector<Image*> attachments, SwapChain& swap_chain);
+	Framebuffer(Device &device, RenderPass& render_pass, std::vector<Image*> attachments, VkExtent2D extent);
 	~Framebuffer();
 
 	VkFramebuffer get();
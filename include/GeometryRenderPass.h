@@ -11,6 +11,12 @@
 #include "Queue.h"
 #include "DescriptorSetInfo.h"
 #include "Sampler.h"
+#include "UniformRingBuffer.h"
+#include "UploadManager.h"
+#include "ResourcePools.h"
+#include "RenderGraph.h"
+#include "ComputeScheduler.h"
+#include "ParallelRecorder.h"
 
 class GeometryRenderPass {
 public:
@@ -20,17 +26,27 @@ public:
 		glm::vec2 tex_coord;
 	};
 
-	GeometryRenderPass(Device& device, SwapChain& swap_chain, std::vector<SubpassDependency> dependancies = {});
-	void update_swapchain(SwapChain& swap_chain);
-	void prepare_framebuffers();
-	void create_buffers(CommandPool& setup_command_pool, Queue& transfer_queue);
+	GeometryRenderPass(Device& device, uint32_t draw_count = 0);
+	~GeometryRenderPass();
+	void add_to_graph(RenderGraph& graph, GraphImage target, ParallelRecorder& parallel_recorder);
+	void create_buffers(UploadManager& upload_manager);
 	void prepare_pipeline();
-	void record_commands(CommandBuffer& command_buffer, uint32_t current_framebuffer, uint32_t current_frame);
+	void record_commands(CommandBuffer& command_buffer);
+	void record_draws(CommandBuffer& command_buffer, uint32_t first, uint32_t count);
+	void record_compute(ComputeScheduler& compute_scheduler, CommandBuffer& command_buffer);
 	void setup_descriptor_sets(uint32_t num_descriptor_sets);
 	void prepare_descriptor_sets(uint32_t num_descriptor_sets);
 	void update_descriptor_sets(uint32_t screen_width, uint32_t screen_height, uint32_t buffer_index);
 
 private:
+	static constexpr uint32_t instance_count = 64;
+	// Instances_comp's Instance, padded so every instance starts on a valid dynamic offset
+	static constexpr uint32_t instance_stride = 256;
+	static constexpr uint32_t instances_per_workgroup = 64;
+
+	// At least one per instance. Past instance_count the draws repeat the instances, only adding recording work
+	const uint32_t draw_count;
+
 	struct Transformations {
 		glm::mat4 model;
 		glm::mat4 view;
@@ -55,19 +71,30 @@ private:
 	};
 	
 	Device& device;
-	Sampler sampler;
-	std::unique_ptr<RenderPass> render_pass;
-	SwapChain* swap_chain;
-	std::vector<std::unique_ptr<Framebuffer>> framebuffers;
-	std::unique_ptr<Pipeline> pipeline;
-	std::unique_ptr<Buffer> vertex_buffer;
-	std::unique_ptr<Buffer> index_buffer;
+	ResourcePools& resources;
+	Handle<Sampler> sampler;
+	RenderGraph* graph = nullptr;
+	RenderGraph::Pass* pass = nullptr;
+	ParallelRecorder* parallel_recorder = nullptr;
+	// Made once, as constructing it each frame could allocate
+	ParallelRecorder::RecordRange record_range;
+	Handle<Pipeline> pipeline;
+	Handle<ComputePipeline> compute_pipeline;
+	Handle<Buffer> vertex_buffer;
+	Handle<Buffer> index_buffer;
+	UploadManager* upload_manager = nullptr;
+	UploadTicket upload_ticket = 0;
 
 	std::unique_ptr<DescriptorPool> descriptor_pool;
-	boost::ptr_vector<Buffer> descriptor_set_buffers{};
-	std::unique_ptr<Image> image;
-	std::unique_ptr<Image> depth_image;
+	std::unique_ptr<DescriptorPool> compute_descriptor_pool;
+	// Holds the frame's base transformations, which the compute shader spreads across the instances
+	std::unique_ptr<UniformRingBuffer> uniform_buffer;
+	// Each frame's instance transformations, written on the compute queue and read by the vertex shader
+	boost::ptr_vector<Buffer> instance_buffers;
+	uint32_t transformations_offset = 0;
+	uint32_t current_frame = 0;
+	Handle<Image> image;
 	std::vector<DescriptorSetInfo> descriptor_sets;
-	AttachmentDescriptions attachment_descriptions{};
+	std::vector<DescriptorSetInfo> compute_descriptor_sets;
 };
 
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <string>
+#include <cstddef>
+
+/**
+ * Host allocations made by the driver in one VkSystemAllocationScope
+ */
+struct ScopeStatistics {
+	size_t current_bytes = 0;
+	size_t peak_bytes = 0;
+	uint64_t allocations = 0;
+	uint64_t reallocations = 0;
+	uint64_t frees = 0;
+	size_t internal_bytes = 0;
+};
+
+struct HostAllocatorStatistics {
+	std::array<ScopeStatistics, VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1> scopes{};
+	uint64_t arena_overflows = 0;
+	size_t pooled_bytes = 0;
+
+	std::string to_json() const;
+};
+
+/**
+ * The VkAllocationCallbacks given to every Vulkan create and destroy call, so driver host allocations go
+ * through us instead of the general purpose heap. Command scope allocations only live for the call that
+ * made them, so they're bump-allocated from an arena reset each frame. Object scope allocations come from
+ * free lists of power of two size classes. Everything else goes to the heap
+ */
+class HostAllocator {
+public:
+	static constexpr size_t arena_size = 1024 * 1024;
+	static constexpr size_t slab_size = 64 * 1024;
+	static constexpr size_t min_size_class = 16;
+	static constexpr size_t max_size_class = 4096;
+	static constexpr size_t max_pooled_alignment = 64;
+
+	static HostAllocator& get();
+	static const VkAllocationCallbacks* callbacks();
+
+	HostAllocator(const HostAllocator&) = delete;
+	~HostAllocator();
+
+	void begin_frame();
+	HostAllocatorStatistics get_statistics();
+
+private:
+	enum class Source : uint8_t {
+		ARENA,
+		POOL,
+		HEAP
+	};
+
+	// Stored just before every pointer handed out
+	struct Header {
+		size_t size;
+		uint32_t offset;
+		uint32_t alignment;
+		Source source;
+		uint8_t scope;
+		uint8_t size_class;
+	};
+
+	static constexpr size_t size_class_count = 9;
+
+	VkAllocationCallbacks allocation_callbacks{};
+	std::mutex mutex;
+	HostAllocatorStatistics statistics{};
+
+	char* arena;
+	size_t arena_head = 0;
+	uint32_t arena_live = 0;
+
+	std::array<std::vector<char*>, size_class_count> free_slots;
+	std::vector<char*> slabs;
+
+	HostAllocator();
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void free(void* memory);
+
+	char* allocate_from_arena(size_t size, size_t alignment, uint32_t& offset);
+	char* allocate_from_pool(size_t total_size, uint8_t& size_class);
+	char* allocate_from_heap(size_t size, size_t alignment, uint32_t& offset);
+
+	static void* VKAPI_PTR vk_allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_PTR vk_reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_PTR vk_free(void* user_data, void* memory);
+	static void VKAPI_PTR vk_internal_allocation(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_PTR vk_internal_free(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+};
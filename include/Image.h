@@ -2,8 +2,11 @@
 
 #include <vulkan/vulkan.h>
 #include <exception>
+#include <vector>
 
 #include "Device.h"
+#include "MemoryAllocator.h"
+#include "Defragmentable.h"
 #include "Logger.h"
 
 enum class ImageType {
@@ -12,21 +15,73 @@ enum class ImageType {
 	STENCIL
 };
 
-class Image {
+/**
+ * How a subresource was last used, or will next be used. Barriers are worked out from the last state to the next
+ */
+struct ImageState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags stage = 0;
+	VkAccessFlags access = 0;
+
+	static ImageState for_layout(VkImageLayout layout);
+	bool is_read_only() const;
+};
+
+class Image : public Defragmentable {
 public:
 	Image(const Device& device, VkImage vk_image, const VkFormat format, ImageType image_type = ImageType::COLOUR);
-	Image(const Device& device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type = ImageType::COLOUR);
+	Image(const Device& device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type = ImageType::COLOUR, bool transient = false);
+	Image(const Device& device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type, VkImageUsageFlags usage);
 	Image(const Image&) = delete;
 	~Image();
 
 	const VkImage get() const;
 	const VkImageView get_view() const;
+	bool is_transient() const;
+
+	VkMemoryRequirements get_memory_requirements() const;
+	void bind_memory(const Allocation& allocation);
+
+	VkImageAspectFlags get_aspect() const;
+	uint32_t get_mip_levels() const;
+	uint32_t get_array_layers() const;
+	const ImageState& get_state(uint32_t mip_level = 0, uint32_t array_layer = 0) const;
+	void set_state(const ImageState& state, uint32_t mip_level = 0, uint32_t array_layer = 0);
+
+	void enable_defragmentation();
+
+	const Allocation& get_allocation() const override;
+	void record_move(CommandBuffer& command_buffer, const Allocation& new_allocation) override;
+	std::unique_ptr<Defragmentable> finish_move() override;
+	void cancel_move() override;
+
 private:
 	const Device& device;
 	VkImage image;
-	VkDeviceMemory memory;
-	VkImageView image_view;
+	Allocation allocation;
+	VkImageView image_view = VK_NULL_HANDLE;
 	bool manage_image_memory;
+	// Bound to memory shared with other images, which this doesn't free
+	bool aliased = false;
+
+	VkFormat format;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	ImageType image_type;
+	bool transient = false;
+	// Overrides the usage worked out from the image type
+	VkImageUsageFlags usage = 0;
+	uint32_t mip_levels = 1;
+	uint32_t array_layers = 1;
+	// Indexed by array_layer * mip_levels + mip_level. Tracked as commands are recorded, so it assumes
+	// command buffers are submitted in the order they were recorded
+	std::vector<ImageState> states;
+
+	bool movable = false;
+	std::unique_ptr<Image> moved_image;
+
+	Image(const Image& source, const Allocation& allocation);
 
+	void create_image(VkMemoryRequirements& requirements);
 	void create_image_view(const VkFormat format, ImageType image_type);
 };
\ No newline at end of file
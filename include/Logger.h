@@ -4,6 +4,7 @@
 #include <iostream>
 
 #include "Settings.h"
+#include "AllocationTracker.h"
 
 namespace Logger {
 	enum LogLevel {
@@ -15,6 +16,7 @@ namespace Logger {
 	};
 
 	static void log(std::string message, LogLevel level = INFO) {
+		AllocationSite site("Logger::log");
 		switch (level) {
 		case INFO:
 			std::cout << "[INFO]     " << message << std::endl;
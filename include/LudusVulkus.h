@@ -3,14 +3,37 @@
 #include "resource.h"
 
 #include <memory>
+#include <optional>
+#include <string>
 
 #include "Application.h"
 #include "Window.h"
 #include "Logger.h"
+#include "AllocationTracker.h"
 
 template <class App>
 class LudusVulkus {
 public:
+    /**
+     * Runs warmup_frames in a hidden window, then counts heap allocations over test_frames.
+     * Throws if the frame loop allocated at all, after logging where the allocations came from
+     */
+    void enable_allocation_test(uint32_t warmup_frames, uint32_t test_frames) {
+        if (!AllocationTracker::available) {
+            throw std::runtime_error("The allocation test needs ALLOCATION_TEST defined - build the AllocationTest configuration");
+        }
+        allocation_test = true;
+        allocation_test_warmup_frames = warmup_frames;
+        allocation_test_frames = test_frames;
+    }
+
+    /**
+     * Records draw_count draws a frame instead of one per instance, to load up the threads recording them
+     */
+    void enable_stress_test(uint32_t draw_count) {
+        stress_draw_count = draw_count;
+    }
+
     void run() {
         Logger::log("Starting application");
 
@@ -24,14 +47,14 @@ public:
         Instance instance(
             App::name, App::version,                          // App details
             "Ludus Vulkus", Version{ 1, 0, 0 },     // Engine details
-            VK_API_VERSION_1_0,                     // Vulkan version
+            VK_API_VERSION_1_2,                     // Vulkan version
             settings,                               // Reference to settings
             prepare_extensions(),                   // Extensions to load
             validation_layers                       // Validation layers to load
         );
 
         // Initialise Window
-        Window window(App::name, 800, 600);
+        Window window(App::name, 800, 600, true, !allocation_test);
 
         Surface surface(instance, window);
 
@@ -39,6 +62,7 @@ public:
         // Physical devices are ordered such that the most suitable for graphics are listed first
         // As such we'll just use the first device we find for now
         PhysicalDevice& physical_device = physical_devices.at(0);
+        add_optional_device_extensions(physical_device, device_extensions);
         Device device(physical_device, physical_device.selected_family.at(GRAPHICS), settings, device_extensions, validation_layers);
 
         App app(instance, device, window, surface, settings);
@@ -47,7 +71,14 @@ public:
 
         app.prepare();
 
+        uint32_t frame = 0;
         while (!window.should_close()) {
+            if (allocation_test) {
+                if (frame == allocation_test_warmup_frames) AllocationTracker::start();
+                if (frame == allocation_test_warmup_frames + allocation_test_frames) break;
+            }
+            frame++;
+
             glfwPollEvents();
 
             try {
@@ -57,12 +88,36 @@ public:
                 app.recreate_swapchain();
             }
         }
+
+        std::optional<AllocationTracker::Report> allocation_report;
+        if (allocation_test) allocation_report = AllocationTracker::stop();
+
         app.on_close();
+
+        if (allocation_report.has_value()) check_allocation_report(allocation_report.value());
     }
 
 private:
     Settings settings;
 
+    bool allocation_test = false;
+    uint32_t allocation_test_warmup_frames = 0;
+    uint32_t allocation_test_frames = 0;
+    uint32_t stress_draw_count = 0;
+
+    void check_allocation_report(const AllocationTracker::Report& report) {
+        double per_frame = allocation_test_frames > 0 ? report.allocations / (double) allocation_test_frames : 0.0;
+        Logger::log("Allocation test: " + std::to_string(report.allocations) + " heap allocations (" + std::to_string(report.bytes) + " bytes) over "
+            + std::to_string(allocation_test_frames) + " frames, " + std::to_string(per_frame) + " per frame");
+        for (auto& site : report.sites) {
+            Logger::log("    " + site.site + ": " + std::to_string(site.allocations) + " allocations, " + std::to_string(site.bytes) + " bytes");
+        }
+
+        if (report.allocations > 0) {
+            throw std::runtime_error("Allocation test failed - the frame loop allocated on the heap after warming up");
+        }
+    }
+
     void setup_settings() {
 #ifdef NDEBUG
         bool debug = false;
@@ -78,6 +133,10 @@ private:
         settings.layer_error_enable = true;
 
         settings.is_mobile = is_mobile();
+
+        settings.queue_priorities = { 1.0f, 0.5f };
+
+        settings.stress_draw_count = stress_draw_count;
     }
 
 #ifdef __APPLE__
@@ -141,6 +200,15 @@ private:
         return layers;
     }
 
+    /**
+     * Extensions we can make use of but can run without
+     */
+    void add_optional_device_extensions(const PhysicalDevice& physical_device, std::set<std::string>& extensions) {
+        if (physical_device.supports_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+            extensions.insert(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+    }
+
     std::set<std::string> select_validation_layers() {
         std::set<std::string> layers = std::set<std::string>();
         layers.insert("VK_LAYER_KHRONOS_validation");
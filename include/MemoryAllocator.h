@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+
+class Device;
+class MemoryBlock;
+class Defragmentable;
+class Defragmenter;
+
+/**
+ * Whether a resource uses linear or optimal tiling. Linear (buffers) and optimal (images) resources
+ * placed next to each other in the same block must be separated by bufferImageGranularity
+ */
+enum class AllocationTiling {
+	LINEAR,
+	OPTIMAL
+};
+
+/**
+ * What an allocation is used for, so memory usage can be broken down in reports
+ */
+enum class MemoryCategory {
+	VERTEX,
+	INDEX,
+	UNIFORM,
+	TEXTURE,
+	DEPTH,
+	STAGING,
+	OTHER,
+	COUNT
+};
+
+/**
+ * A range of device memory handed out by the MemoryAllocator. Resources bind to memory at offset
+ */
+struct Allocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	uint32_t memory_type = 0;
+	VkDeviceSize alignment = 1;
+	AllocationTiling tiling = AllocationTiling::LINEAR;
+	MemoryCategory category = MemoryCategory::OTHER;
+	MemoryBlock* block = nullptr;
+};
+
+/**
+ * The buffer or image an allocation is for, and whether the driver wants it in memory of its own. Dedicated
+ * memory is allocated for that resource alone, so the driver can place it as it likes (e.g. for compression)
+ */
+struct DedicatedResource {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkImage image = VK_NULL_HANDLE;
+	bool prefers_dedicated = false;
+	bool requires_dedicated = false;
+};
+
+/**
+ * Usage of a single memory heap. budget and usage come from VK_EXT_memory_budget when it's enabled,
+ * otherwise budget is the heap size and usage is what this allocator has allocated
+ */
+struct HeapStatistics {
+	VkDeviceSize heap_size = 0;
+	bool device_local = false;
+	VkDeviceSize budget = 0;
+	VkDeviceSize usage = 0;
+	VkDeviceSize block_bytes = 0;
+	uint32_t block_count = 0;
+	VkDeviceSize allocated_bytes = 0;
+	uint32_t allocation_count = 0;
+	std::array<VkDeviceSize, static_cast<size_t>(MemoryCategory::COUNT)> category_bytes{};
+};
+
+struct MemoryStatistics {
+	bool has_memory_budget = false;
+	std::vector<HeapStatistics> heaps;
+
+	VkDeviceSize get_category_bytes(MemoryCategory category) const;
+	std::string to_json() const;
+};
+
+/**
+ * A single vkAllocateMemory call, split up into ranges which are either free or in use
+ */
+class MemoryBlock {
+public:
+	struct Range {
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		bool free;
+		AllocationTiling tiling;
+		Defragmentable* owner = nullptr;
+	};
+
+	MemoryBlock(const Device& device, uint32_t memory_type, VkDeviceSize size, bool dedicated, const DedicatedResource& resource = {});
+	MemoryBlock(const MemoryBlock&) = delete;
+	~MemoryBlock();
+
+	VkDeviceMemory get() const;
+
+	std::optional<VkDeviceSize> allocate(VkDeviceSize size, VkDeviceSize alignment, AllocationTiling tiling, VkDeviceSize granularity);
+	void free(VkDeviceSize offset);
+	bool empty() const;
+	VkDeviceSize get_used_bytes() const;
+
+	void set_owner(VkDeviceSize offset, Defragmentable* owner);
+	std::vector<Defragmentable*> get_owners() const;
+
+	void* map();
+	void unmap();
+
+	const uint32_t memory_type;
+	const VkDeviceSize size;
+	const bool dedicated;
+
+private:
+	const Device& device;
+	VkDeviceMemory memory;
+	std::vector<Range> ranges;
+	void* mapped_memory = nullptr;
+	uint32_t map_count = 0;
+	VkDeviceSize used_bytes = 0;
+};
+
+/**
+ * Owned by the Device. Keeps large blocks of memory for each memory type and sub-allocates
+ * buffers and images from them, so we don't need a vkAllocateMemory per resource
+ */
+class MemoryAllocator {
+public:
+	static constexpr VkDeviceSize default_block_size = 64ull * 1024 * 1024;
+
+	MemoryAllocator(const Device& device);
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	~MemoryAllocator();
+
+	static std::string category_name(MemoryCategory category);
+
+	Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationTiling tiling, MemoryCategory category = MemoryCategory::OTHER, VkMemoryPropertyFlags preferred_properties = 0, const DedicatedResource& resource = {});
+	DedicatedResource query_dedicated(VkBuffer buffer) const;
+	DedicatedResource query_dedicated(VkImage image) const;
+	void free(Allocation& allocation);
+
+	void* map(const Allocation& allocation);
+	void unmap(const Allocation& allocation);
+
+	bool is_coherent(const Allocation& allocation) const;
+	VkMappedMemoryRange get_mapped_range(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+	MemoryStatistics get_statistics() const;
+	bool has_direct_write_memory(const VkMemoryRequirements& requirements) const;
+
+	void set_owner(const Allocation& allocation, Defragmentable* owner);
+	void release_owner(const Allocation& allocation, Defragmentable* owner);
+	void notify_written(Defragmentable* owner);
+	void set_defragmenter(Defragmenter* defragmenter);
+	MemoryBlock* find_sparsest_block(uint32_t memory_type) const;
+	std::optional<Allocation> reallocate(const Allocation& allocation, const MemoryBlock* excluded_block);
+	void notify_moved();
+	uint64_t get_move_generation() const;
+
+private:
+	const Device& device;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize buffer_image_granularity;
+	VkDeviceSize non_coherent_atom_size;
+	uint32_t allocation_count = 0;
+	std::array<std::vector<std::unique_ptr<MemoryBlock>>, VK_MAX_MEMORY_TYPES> blocks;
+	std::array<HeapStatistics, VK_MAX_MEMORY_HEAPS> heap_statistics{};
+	bool has_memory_budget;
+	Defragmenter* defragmenter = nullptr;
+	uint64_t move_generation = 0;
+
+	Allocation create_allocation(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size, VkDeviceSize alignment, AllocationTiling tiling, MemoryCategory category);
+	HeapStatistics& get_heap_statistics(uint32_t memory_type);
+	HeapStatistics measure_heap(uint32_t heap_index) const;
+	void log_budget_warning(uint32_t memory_type, VkDeviceSize size) const;
+
+	VkDeviceSize preferred_block_size(uint32_t memory_type) const;
+	MemoryBlock& create_block(uint32_t memory_type, VkDeviceSize size, VkDeviceSize minimum_size, bool dedicated, const DedicatedResource& resource = {});
+	void release_block(MemoryBlock* block);
+};
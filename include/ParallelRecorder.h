@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "Device.h"
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+
+/**
+ * Splits a render pass's draw list across threads. Each thread records its share into a secondary command
+ * buffer, and the primary then executes them in draw order. A command pool can only be used by one thread at
+ * a time, so each thread has its own transient pool per frame in flight, reset by begin_frame().
+ *
+ * The primary must be inside a render pass begun with SECONDARY_COMMAND_BUFFERS contents
+ */
+class ParallelRecorder {
+public:
+	// Records draws [first, first + count). Runs on worker threads, so it mustn't use the frame arena
+	using RecordRange = std::function<void(CommandBuffer& command_buffer, uint32_t first, uint32_t count)>;
+
+	static constexpr uint32_t default_min_draws_per_thread = 64;
+
+	ParallelRecorder(Device& device, uint32_t frames_in_flight, uint32_t thread_count = std::thread::hardware_concurrency());
+	ParallelRecorder(const ParallelRecorder&) = delete;
+	~ParallelRecorder();
+
+	void begin_frame(uint32_t frame);
+	void record(CommandBuffer& primary, uint32_t draw_count, const RecordRange& record_range, uint32_t min_draws_per_thread = default_min_draws_per_thread);
+
+	uint32_t get_thread_count() const;
+
+private:
+	Device& device;
+	const uint32_t thread_count;
+	// Indexed by frame, then thread. The calling thread is thread 0
+	std::vector<std::vector<std::unique_ptr<CommandPool>>> pools;
+	uint32_t current_frame = 0;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable work_done;
+	// Bumped for each record() so workers know there's a new draw list
+	uint64_t generation = 0;
+	uint32_t remaining = 0;
+	bool stopping = false;
+
+	// The draw list being recorded, split into one chunk per thread
+	const CommandBuffer* primary = nullptr;
+	const RecordRange* record_range = nullptr;
+	uint32_t draw_count = 0;
+	uint32_t chunk_count = 0;
+	std::vector<CommandBuffer*> secondary_command_buffers;
+	std::exception_ptr error;
+
+	void work(uint32_t thread);
+	void record_chunk(uint32_t thread);
+};
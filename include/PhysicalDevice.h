@@ -23,19 +23,23 @@ public:
 
 	VkPhysicalDevice get() const;
 	VkPhysicalDeviceMemoryProperties get_memory_properties() const;
-	uint32_t find_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties) const;
+	uint32_t find_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred_properties = 0) const;
+	bool has_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties) const;
 	VkFormat first_supported_format(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+	bool supports_extension(const std::string& extension) const;
 		
 	std::vector<QueueFamily> queue_families;
 	std::map<QueueType, QueueFamily> selected_family;
 	VkPhysicalDeviceProperties device_properties;
 	VkPhysicalDeviceFeatures device_features;
+	bool supports_timeline_semaphores = false;
 
 private:
 	VkPhysicalDevice device;
 	
+	void select_queue_families();
 	int find_suitability(std::set<std::string> required_extensions, Surface& surface);
 	bool has_required_extension_support(std::set<std::string> required_extensions);
-	std::vector<VkExtensionProperties> get_supported_extensions();
+	std::vector<VkExtensionProperties> get_supported_extensions() const;
 };
 
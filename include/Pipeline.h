@@ -6,8 +6,9 @@
 #include "RenderPass.h"
 #include "AttributeDescriptor.h"
 
+// COMPUTE is already a QueueType
 enum ShaderType {
-	VERTEX, FRAGMENT
+	VERTEX, FRAGMENT, COMPUTE_SHADER
 };
 
 class Pipeline {
@@ -18,15 +19,17 @@ public:
 	VkPipeline get();
 	VkPipelineLayout get_layout();
 	VkDescriptorSetLayout get_descriptor_set_layout();
+	VkPipelineBindPoint get_bind_point() const;
 
 	void create(Shader& vertex_shader, Shader& fragment_shader, RenderPass& render_pass);
 	void set_attribute_descriptor(AttributeDescriptor attribute_descriptor);
 	void add_descriptor_set_binding(uint32_t binding, VkShaderStageFlags shader_stages, VkDescriptorType descriptor_type);
 	void enable_depth_test();
 
-private:
+protected:
 	Device &device;
 
+	VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	bool setup = false;
 	bool depth_test = false;
 	VkPipelineLayout pipeline_layout;
@@ -37,6 +40,9 @@ private:
 	std::vector<VkDescriptorSetLayoutBinding> descriptor_set_bindings;
 
 	VkPipelineShaderStageCreateInfo create_shader_stage(Shader& shader, ShaderType type);
+	void create_pipeline_layout();
+
+private:
 	VkPipelineDynamicStateCreateInfo create_dynamic_state(DynamicState& dynamic_state);
 	VkPipelineVertexInputStateCreateInfo create_vertex_input_state();
 	VkPipelineInputAssemblyStateCreateInfo create_input_assembly_state();
@@ -49,3 +55,14 @@ private:
 	void create_descriptor_set_layout();
 };
 
+/**
+ * A pipeline running a single compute shader. Descriptor set bindings are added the same way as for a
+ * graphics pipeline, and it's bound and dispatched through CommandBuffer
+ */
+class ComputePipeline : public Pipeline {
+public:
+	ComputePipeline(Device& device);
+
+	void create(Shader& compute_shader);
+};
+
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+
+#include "Pipeline.h"
+#include "Shader.h"
+#include "CommandBuffer.h"
+#include "DescriptorPool.h"
+#include "DescriptorSetInfo.h"
+#include "Sampler.h"
+#include "ResourcePools.h"
+#include "RenderGraph.h"
+
+/**
+ * Softens the scene with a separable blur before it's composited into the target. Each step draws a fullscreen
+ * triangle sampling the image the step before wrote, all in images the graph owns. The scene and the vertical
+ * blur are never in use at the same time, so the graph gives them the same memory
+ */
+class PostProcessRenderPass {
+public:
+	PostProcessRenderPass(Device& device);
+	~PostProcessRenderPass();
+	void add_to_graph(RenderGraph& graph, GraphImage source, GraphImage target, VkFormat format);
+	void prepare_pipelines();
+	void prepare_descriptor_sets(uint32_t num_descriptor_sets);
+	void update_descriptor_sets(uint32_t buffer_index);
+	void on_resize();
+
+	GraphImage get_blurred() const;
+
+private:
+	struct Step {
+		std::string fragment_shader;
+		GraphImage input;
+		RenderGraph::Pass* pass = nullptr;
+		Handle<Pipeline> pipeline;
+		std::unique_ptr<DescriptorPool> descriptor_pool;
+		std::vector<DescriptorSetInfo> descriptor_sets;
+	};
+
+	Device& device;
+	ResourcePools& resources;
+	Handle<Sampler> sampler;
+	RenderGraph* graph = nullptr;
+	GraphImage blurred;
+	uint32_t current_frame = 0;
+	std::array<Step, 3> steps;
+
+	void record_commands(CommandBuffer& command_buffer, Step& step);
+	std::vector<DescriptorPool::DescriptorAccess> get_descriptor_accesses(const Step& step) const;
+};
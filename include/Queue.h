@@ -2,6 +2,7 @@
 
 #include <vulkan/vulkan.h>
 #include <optional>
+#include <span>
 
 #include "QueueFamily.h"
 #include "CommandBuffer.h"
@@ -9,31 +10,68 @@
 #include "Type.h"
 #include "SwapChain.h"
 #include "Fence.h"
+#include "TimelineSemaphore.h"
 
 #include <optional>
+#include <memory>
+#include <mutex>
+#include <atomic>
 
 class Device;
+class Queue;
+class SubmitBatch;
 
+/**
+ * Makes a submit wait until another (or the same) queue's timeline reaches value
+ */
+struct TimelineWait {
+	Queue* queue;
+	uint64_t value;
+	VkPipelineStageFlags stage;
+};
+
+/**
+ * Every submit signals the queue's timeline semaphore with the next value, and returns that value. Work on the
+ * queue has finished once the timeline reaches it, so callers keep the value rather than a fence.
+ *
+ * Submits and presents take the queue's own lock, so threads can submit to different queues without waiting
+ * on each other, and to the same queue safely
+ */
 class Queue {
 public:
-	VkDeviceQueueCreateInfo queue_create_info{};
-
-	Queue(QueueFamily& queue_family);
+	Queue(QueueFamily& queue_family, uint32_t queue_index, float priority);
+	Queue(const Queue&) = delete;
 
 	void setup_queue(Device &device);
-	void submit(CommandBuffer& command_buffer);
-	void submit(CommandBuffer &command_buffer, std::vector<std::pair<Semaphore *, VkPipelineStageFlags>> &wait_semaphores, std::vector<Semaphore *> &signal_semaphores, std::optional<Fence *> fence = std::nullopt);
-	void present(SwapChain& swap_chain, uint32_t index, std::vector<Semaphore *>& wait_semaphores);
+	void teardown_queue();
+	uint64_t submit(CommandBuffer& command_buffer);
+	uint64_t submit(CommandBuffer &command_buffer, std::span<const std::pair<Semaphore *, VkPipelineStageFlags>> wait_semaphores, std::span<Semaphore * const> signal_semaphores, std::span<const TimelineWait> timeline_waits = {}, std::optional<Fence *> fence = std::nullopt);
+	uint64_t submit(SubmitBatch& batch, std::optional<Fence *> fence = std::nullopt);
+	void present(SwapChain& swap_chain, uint32_t index, std::span<Semaphore * const> wait_semaphores);
 	void wait_idle();
+	std::unique_lock<std::mutex> lock_submits();
+
+	bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+	bool is_complete(uint64_t value);
+	uint64_t get_submitted_value() const;
+	uint64_t get_completed_value();
 
 	VkQueue& get();
+	TimelineSemaphore& get_timeline();
+	uint32_t get_index() const;
+	float get_priority() const;
 
 	QueueFamily queue_family;
 
 private:
-	const float priority = 1.0f;
+	// Index within the family
+	const uint32_t queue_index;
+	const float priority;
 	
 	std::optional<VkQueue> queue;
+	std::unique_ptr<TimelineSemaphore> timeline;
+	std::mutex submit_mutex;
+	std::atomic<uint64_t> submitted_value = 0;
 
 	void assert_setup();
 };
@@ -19,6 +19,7 @@ public:
 	}
 
 	uint32_t index;
+	uint32_t queue_count;
 	bool supports_graphics = false;
 	bool supports_compute = false;
 	bool supports_transfer = false;
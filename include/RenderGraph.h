@@ -0,0 +1,210 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <optional>
+
+#include "Device.h"
+#include "Image.h"
+#include "Buffer.h"
+#include "RenderPass.h"
+#include "Framebuffer.h"
+#include "AttachmentDescriptions.h"
+#include "MemoryAllocator.h"
+#include "ResourcePool.h"
+#include "Type.h"
+
+class CommandBuffer;
+
+struct GraphImage {
+	uint32_t index = UINT32_MAX;
+};
+
+struct GraphBuffer {
+	uint32_t index = UINT32_MAX;
+};
+
+/**
+ * An image the graph creates and owns. A width or height of 0 follows the graph's extent
+ */
+struct GraphImageDescription {
+	VkFormat format;
+	ImageType image_type = ImageType::COLOUR;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+enum class PassType {
+	GRAPHICS,
+	COMPUTE,
+	TRANSFER
+};
+
+/**
+ * A frame described as passes and the resources they read and write. compile() culls passes nothing
+ * depends on, orders the rest, builds a render pass with load/store ops, layouts and subpass dependencies
+ * for each graphics pass, and backs the graph's own images with memory - images which are never used at
+ * the same time share it. execute() then records every pass, inserting the barriers between them.
+ *
+ * Passes are declared in the order their results should be seen, so a pass sees what earlier passes wrote.
+ * Imported images and buffers outlive the frame, so passes writing them are never culled
+ */
+class RenderGraph {
+public:
+	class Pass {
+	public:
+		void write_colour(GraphImage image);
+		void write_depth(GraphImage image);
+		void read_texture(GraphImage image, VkPipelineStageFlags stage = PipelineStage::FragmentShader);
+		void read_storage_image(GraphImage image, VkPipelineStageFlags stage = PipelineStage::ComputeShader);
+		void write_storage_image(GraphImage image, VkPipelineStageFlags stage = PipelineStage::ComputeShader);
+		void read_buffer(GraphBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access);
+		void write_buffer(GraphBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access);
+		void set_record(std::function<void(CommandBuffer&)> record);
+		void use_secondary_command_buffers();
+		void keep();
+
+		const std::string name;
+		const PassType type;
+
+	private:
+		friend class RenderGraph;
+
+		struct ImageAccess {
+			uint32_t image;
+			ImageState state;
+			bool attachment;
+		};
+
+		struct BufferAccess {
+			uint32_t buffer;
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+		};
+
+		struct CachedFramebuffer {
+			std::vector<VkImageView> views;
+			Handle<Framebuffer> framebuffer;
+		};
+
+		Pass(const std::string& name, PassType type);
+
+		std::vector<ImageAccess> image_accesses;
+		std::vector<BufferAccess> buffer_accesses;
+		std::function<void(CommandBuffer&)> record;
+		bool kept = false;
+		bool culled = false;
+		bool secondary_contents = false;
+
+		// Built by compile for graphics passes, with attachments in the order of the attachment descriptions
+		std::unique_ptr<RenderPass> render_pass;
+		AttachmentDescriptions attachment_descriptions;
+		std::vector<ImageAccess> attachments;
+		std::vector<ImageState> final_states;
+		std::vector<CachedFramebuffer> framebuffers;
+
+		bool uses(uint32_t image) const;
+		bool uses_buffer(uint32_t buffer) const;
+		bool writes(uint32_t image) const;
+		bool writes_buffer(uint32_t buffer) const;
+		void add_image_access(GraphImage image, const ImageState& state, bool attachment);
+	};
+
+	RenderGraph(Device& device);
+	RenderGraph(const RenderGraph&) = delete;
+	~RenderGraph();
+
+	GraphImage create_image(const std::string& name, const GraphImageDescription& description);
+	GraphImage import_image(const std::string& name, VkFormat format, const ImageState& incoming_state = {});
+	GraphBuffer import_buffer(const std::string& name);
+	void set_output(GraphImage image, const ImageState& final_state);
+	Pass& add_pass(const std::string& name, PassType type);
+
+	void compile(VkExtent2D extent);
+	void resize(VkExtent2D extent);
+
+	void set_image(GraphImage image, Image& target);
+	void set_buffer(GraphBuffer buffer, Buffer& target);
+	void execute(CommandBuffer& command_buffer);
+
+	RenderPass& get_render_pass(const Pass& pass) const;
+	Image& get_image(GraphImage image) const;
+	bool shares_memory(GraphImage first, GraphImage second) const;
+	VkExtent2D get_extent() const;
+	VkDeviceSize get_image_memory() const;
+	bool is_culled(const Pass& pass) const;
+
+private:
+	static constexpr uint32_t max_cached_framebuffers = 8;
+
+	struct ImageResource {
+		std::string name;
+		VkFormat format;
+		// Only set for images the graph owns
+		std::optional<GraphImageDescription> description;
+		// For imported images, the state they arrive in at the start of each frame
+		ImageState incoming_state;
+		std::optional<ImageState> final_state;
+		Image* image = nullptr;
+		std::unique_ptr<Image> owned;
+
+		VkImageUsageFlags usage = 0;
+		// Positions in the execution order, UINT32_MAX if unused
+		uint32_t first_use = UINT32_MAX;
+		uint32_t last_use = UINT32_MAX;
+		// Image which used this one's memory before it each frame, if aliased
+		std::optional<uint32_t> alias_predecessor;
+	};
+
+	struct BufferResource {
+		std::string name;
+		Buffer* buffer = nullptr;
+		// Tracked across frames, like an image's state. Reads since the last write are gathered up, so the
+		// next write waits on all of them and repeated reads don't need another barrier
+		VkPipelineStageFlags write_stage = 0;
+		VkAccessFlags write_access = 0;
+		VkPipelineStageFlags read_stages = 0;
+		VkAccessFlags read_access = 0;
+	};
+
+	struct MemorySlot {
+		VkMemoryRequirements requirements;
+		std::vector<uint32_t> images;
+		Allocation allocation;
+	};
+
+	Device& device;
+	std::vector<ImageResource> images;
+	std::vector<BufferResource> buffers;
+	std::vector<std::unique_ptr<Pass>> passes;
+	std::vector<Pass*> order;
+	std::vector<MemorySlot> memory_slots;
+	VkExtent2D extent{};
+	bool compiled = false;
+	// Allocator move generation the cached framebuffers were made in. Moved images get new views, which may
+	// reuse the handles of the destroyed ones
+	uint64_t framebuffer_generation = 0;
+
+	// Reused by execute, so recording doesn't allocate
+	std::vector<VkImageView> views;
+	std::vector<Image*> attachment_images;
+
+	static bool conflicts(const Pass& first, const Pass& second);
+	bool is_imported(uint32_t image) const;
+
+	void cull();
+	void sort();
+	void find_lifetimes();
+	void build_render_pass(Pass& pass, uint32_t position);
+	void allocate_images();
+	void free_images();
+	void free_framebuffers();
+
+	std::optional<ImageState> find_previous_state(uint32_t image, uint32_t position) const;
+	Framebuffer& get_framebuffer(Pass& pass);
+	void record_barriers(CommandBuffer& command_buffer, Pass& pass, uint32_t position);
+	void record_pass(CommandBuffer& command_buffer, Pass& pass, uint32_t position);
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <new>
+#include <utility>
+#include <stdexcept>
+#include <cstdint>
+
+/**
+ * 32-bit reference to an object in a ResourcePool. The low bits index the pool's slot and the high bits hold
+ * the slot's generation when the object was created, so handles to destroyed objects are detected
+ */
+template <class T>
+struct Handle {
+	static constexpr uint32_t index_bits = 20;
+	static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+	static constexpr uint32_t generation_mask = (1u << (32 - index_bits)) - 1;
+
+	uint32_t value = 0;
+
+	Handle() = default;
+	Handle(uint32_t index, uint32_t generation) : value((generation << index_bits) | index) {}
+
+	uint32_t index() const { return value & index_mask; }
+	uint32_t generation() const { return value >> index_bits; }
+
+	// Generations start at 1, so a default constructed handle never refers to anything
+	bool is_null() const { return value == 0; }
+
+	bool operator==(const Handle&) const = default;
+};
+
+/**
+ * Dense storage for one type of resource. Objects are constructed in place in fixed size chunks of slots,
+ * so they never move once created (resources hand out pointers to themselves) and iterating or looking
+ * up a handle touches contiguous memory. Destroyed slots are reused, bumping their generation
+ */
+template <class T>
+class ResourcePool {
+public:
+	static constexpr uint32_t chunk_size = 64;
+
+	ResourcePool() = default;
+	ResourcePool(const ResourcePool&) = delete;
+
+	~ResourcePool() {
+		clear();
+	}
+
+	template <class... Args>
+	Handle<T> create(Args&&... args) {
+		uint32_t index;
+		if (!free_slots.empty()) {
+			index = free_slots.back();
+			free_slots.pop_back();
+		} else {
+			index = slot_count++;
+			if (index > Handle<T>::index_mask) {
+				throw std::runtime_error("Resource pool is full");
+			}
+			if (index / chunk_size >= chunks.size()) {
+				chunks.push_back(std::make_unique<Chunk>());
+			}
+		}
+
+		Chunk& chunk = *chunks[index / chunk_size];
+		uint32_t slot = index % chunk_size;
+		try {
+			new (&chunk.objects[slot]) T(std::forward<Args>(args)...);
+		} catch (...) {
+			free_slots.push_back(index);
+			throw;
+		}
+		chunk.alive[slot] = true;
+		live_count++;
+		return Handle<T>(index, chunk.generations[slot]);
+	}
+
+	void destroy(Handle<T> handle) {
+		if (handle.is_null()) return;
+
+		T& object = get(handle);
+		object.~T();
+
+		Chunk& chunk = *chunks[handle.index() / chunk_size];
+		uint32_t slot = handle.index() % chunk_size;
+		chunk.alive[slot] = false;
+		chunk.generations[slot] = next_generation(chunk.generations[slot]);
+		free_slots.push_back(handle.index());
+		live_count--;
+	}
+
+	bool is_valid(Handle<T> handle) const {
+		if (handle.is_null() || handle.index() >= slot_count) return false;
+
+		const Chunk& chunk = *chunks[handle.index() / chunk_size];
+		uint32_t slot = handle.index() % chunk_size;
+		return chunk.alive[slot] && chunk.generations[slot] == handle.generation();
+	}
+
+	T& get(Handle<T> handle) {
+		if (!is_valid(handle)) {
+			throw std::runtime_error("Stale or null resource handle");
+		}
+		return *std::launder(reinterpret_cast<T*>(&chunks[handle.index() / chunk_size]->objects[handle.index() % chunk_size]));
+	}
+
+	const T& get(Handle<T> handle) const {
+		return const_cast<ResourcePool*>(this)->get(handle);
+	}
+
+	uint32_t size() const {
+		return live_count;
+	}
+
+	void clear() {
+		for (uint32_t index = 0; index < slot_count; index++) {
+			Chunk& chunk = *chunks[index / chunk_size];
+			uint32_t slot = index % chunk_size;
+			if (chunk.alive[slot]) {
+				destroy(Handle<T>(index, chunk.generations[slot]));
+			}
+		}
+	}
+
+private:
+	struct Chunk {
+		std::array<std::aligned_storage_t<sizeof(T), alignof(T)>, chunk_size> objects;
+		std::array<uint32_t, chunk_size> generations;
+		std::array<bool, chunk_size> alive{};
+
+		Chunk() {
+			generations.fill(1);
+		}
+	};
+
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::vector<uint32_t> free_slots;
+	uint32_t slot_count = 0;
+	uint32_t live_count = 0;
+
+	static uint32_t next_generation(uint32_t generation) {
+		generation = (generation + 1) & Handle<T>::generation_mask;
+		return generation == 0 ? 1 : generation;
+	}
+};
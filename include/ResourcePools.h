@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ResourcePool.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "Sampler.h"
+#include "Pipeline.h"
+#include "Framebuffer.h"
+
+/**
+ * Owned by the Device. Holds every long-lived GPU resource, referenced elsewhere by Handle.
+ * Pools are destroyed in reverse order, so framebuffers and pipelines go before the images and buffers
+ */
+struct ResourcePools {
+	ResourcePool<Buffer> buffers;
+	ResourcePool<Image> images;
+	ResourcePool<Sampler> samplers;
+	ResourcePool<Pipeline> pipelines;
+	ResourcePool<ComputePipeline> compute_pipelines;
+	ResourcePool<Framebuffer> framebuffers;
+};
@@ -6,7 +6,7 @@
 
 class Sampler {
 public:
-	Sampler(const Device &device);
+	Sampler(const Device &device, VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
 	Sampler(const Sampler&) = delete;
 	~Sampler();
 
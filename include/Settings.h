@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 class Settings {
 public:
     bool use_validation_layers;
@@ -11,4 +13,11 @@ public:
     bool layer_error_enable;
 
     bool is_mobile;
+
+    // Priority of each queue requested from a family, as many as the family has. Queue 0 renders and presents,
+    // while the rest take compute and streaming work sharing the family
+    std::vector<float> queue_priorities;
+
+    // Draws the scene records each frame, spread across threads. 0 draws each instance once
+    uint32_t stress_draw_count;
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <span>
+#include <utility>
+#include <cstdint>
+
+#include "Queue.h"
+
+class CommandBuffer;
+class Semaphore;
+
+/**
+ * Several submits, each with its own command buffers and semaphores, sent to a queue in one vkQueueSubmit by
+ * Queue::submit(SubmitBatch&). Each submit signals the queue's timeline with its own value, so waiting on one
+ * submit doesn't wait on those after it. The batch is emptied once submitted and can be reused, keeping its memory
+ */
+class SubmitBatch {
+public:
+	void add(CommandBuffer& command_buffer, std::span<const std::pair<Semaphore*, VkPipelineStageFlags>> wait_semaphores = {}, std::span<Semaphore* const> signal_semaphores = {}, std::span<const TimelineWait> timeline_waits = {}, uint64_t* signalled_value = nullptr);
+	void add_to_last(CommandBuffer& command_buffer);
+	void clear();
+
+	bool empty() const;
+	uint32_t size() const;
+
+private:
+	friend class Queue;
+
+	// Ranges into the arrays below, which every submit shares
+	struct Submit {
+		uint32_t first_wait;
+		uint32_t wait_count;
+		uint32_t first_command_buffer;
+		uint32_t command_buffer_count;
+		uint32_t first_signal;
+		uint32_t signal_count;
+		// Given the timeline value the submit signals once it's submitted
+		uint64_t* signalled_value;
+	};
+
+	std::vector<Submit> submits;
+	std::vector<VkSemaphore> wait_semaphores;
+	std::vector<VkPipelineStageFlags> wait_stages;
+	std::vector<uint64_t> wait_values;
+	std::vector<VkCommandBuffer> command_buffers;
+	// Each submit's last signal is left for the queue's timeline, filled in when submitted
+	std::vector<VkSemaphore> signal_semaphores;
+	std::vector<uint64_t> signal_values;
+
+	// Built by the queue on submit
+	std::vector<VkTimelineSemaphoreSubmitInfo> timeline_infos;
+	std::vector<VkSubmitInfo> submit_infos;
+};
@@ -1,11 +1,11 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <boost/ptr_container/ptr_vector.hpp>
 
 #include "SwapChainDetails.h"
 #include "Device.h"
 #include "Image.h"
+#include "ResourcePool.h"
 #include "Semaphore.h"
 #include "Fence.h"
 
@@ -24,7 +24,7 @@ public:
 	static VkPresentModeKHR default_presentation_mode(const std::vector<VkPresentModeKHR>& present_modes, Settings& settings);
 	static VkExtent2D default_extent(const VkSurfaceCapabilitiesKHR& capabilities, Window& window);
 
-	SwapChain(Device &device, Window& window, Surface& surface, Settings& settings);
+	SwapChain(Device &device, Window& window, Surface& surface, Settings& settings, SwapChain* old_swap_chain = nullptr);
 	~SwapChain();
 
 	VkSwapchainKHR get();
@@ -35,7 +35,7 @@ public:
 
 	bool out_of_date = false;
 	VkFormat image_format;
-	boost::ptr_vector<Image> images;
+	std::vector<Handle<Image>> images;
 
 private:
 	Device &device;
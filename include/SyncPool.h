@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+#include "Device.h"
+#include "Semaphore.h"
+
+/**
+ * Owned by the Device. Hands out binary semaphores which live as long as the device, e.g. for each frame in
+ * flight. Everything handed out stays owned by the pool, and is destroyed with it
+ */
+class SyncPool {
+public:
+	SyncPool(Device& device);
+	SyncPool(const SyncPool&) = delete;
+	~SyncPool();
+
+	Semaphore& acquire_semaphore();
+
+private:
+	Device& device;
+
+	std::vector<std::unique_ptr<Semaphore>> semaphores;
+};
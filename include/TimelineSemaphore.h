@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+
+#include "Device.h"
+
+/**
+ * A Vulkan 1.2 timeline semaphore - a counter which only increases. Submits signal it with a value and can
+ * wait on any value, and the host can wait on or read it, so one replaces a fence per submit.
+ * Any thread can wait on or read it
+ */
+class TimelineSemaphore {
+public:
+	TimelineSemaphore(Device& device, uint64_t initial_value = 0);
+	TimelineSemaphore(const TimelineSemaphore&) = delete;
+	~TimelineSemaphore();
+
+	VkSemaphore get();
+
+	uint64_t get_value();
+	bool is_complete(uint64_t value);
+	bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+	void signal(uint64_t value);
+
+private:
+	Device& device;
+	VkSemaphore semaphore;
+	// Last value read back, so completed values don't need another query
+	std::atomic<uint64_t> completed_value;
+
+	uint64_t update_completed(uint64_t value);
+};
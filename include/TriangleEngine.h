@@ -4,7 +4,6 @@
 
 #include "Application.h"
 #include "Semaphore.h"
-#include "Fence.h"
 #include "TriangleRenderPass.h"
 
 #define FRAMES_IN_FLIGHT 2
@@ -12,10 +11,12 @@
 class TriangleEngine : public Application {
 public:
 	struct Frame {
-		CommandBuffer& command_buffer;
-		std::unique_ptr<Semaphore> image_available;
-		std::unique_ptr<Semaphore> render_finished;
-		std::unique_ptr<Fence> image_in_flight;
+		// Transient, and reset as a whole once the frame's last submit has finished
+		std::unique_ptr<CommandPool> command_pool;
+		Semaphore& image_available;
+		Semaphore& render_finished;
+		// Graphics timeline value of the frame's last submit
+		uint64_t timeline_value = 0;
 	};
 
 	static inline const std::string name = "Triangle Engine";
@@ -32,6 +33,8 @@ public:
 private:
 	uint32_t current_frame = 0;
 	std::array<std::unique_ptr<Frame>, FRAMES_IN_FLIGHT> frames;
+	std::unique_ptr<RenderGraph> graph;
+	GraphImage backbuffer;
 	std::unique_ptr<TriangleRenderPass> render_pass;
 };
 
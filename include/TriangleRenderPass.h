@@ -9,6 +9,9 @@
 #include "SwapChain.h"
 #include "CommandBuffer.h"
 #include "Queue.h"
+#include "UploadManager.h"
+#include "ResourcePools.h"
+#include "RenderGraph.h"
 
 class TriangleRenderPass {
 public:
@@ -17,11 +20,11 @@ public:
 		glm::vec3 color;
 	};
 
-	TriangleRenderPass(Device& device, SwapChain &swap_chain, std::vector<SubpassDependency> dependancies = {});
-	void update_swapchain(SwapChain& swap_chain);
-	void prepare_framebuffers();
-	void prepare_pipeline(CommandPool& setup_command_pool, Queue& transfer_queue);
-	void record_commands(CommandBuffer &command_buffer, uint32_t current_framebuffer);
+	TriangleRenderPass(Device& device);
+	~TriangleRenderPass();
+	void add_to_graph(RenderGraph& graph, GraphImage target);
+	void prepare_pipeline(UploadManager& upload_manager);
+	void record_commands(CommandBuffer &command_buffer);
 
 private:
 	// Describes a triangle
@@ -32,11 +35,12 @@ private:
 	};
 
 	Device& device;
-	std::unique_ptr<RenderPass> render_pass;
-	SwapChain *swap_chain;
-	std::vector<std::unique_ptr<Framebuffer>> framebuffers;
-	std::unique_ptr<Pipeline> pipeline;
-	std::unique_ptr<Buffer> buffer;
-	AttachmentDescriptions attachment_descriptions{};
+	ResourcePools& resources;
+	RenderGraph* graph = nullptr;
+	RenderGraph::Pass* pass = nullptr;
+	Handle<Pipeline> pipeline;
+	Handle<Buffer> buffer;
+	UploadManager* upload_manager = nullptr;
+	UploadTicket upload_ticket = 0;
 };
 
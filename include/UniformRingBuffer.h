@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <vector>
+
+#include "Device.h"
+#include "Buffer.h"
+
+/**
+ * One persistently mapped uniform buffer per frame in flight. Each frame the buffer is reset and
+ * uniform data is bump-allocated from it, returning the offset to bind with UNIFORM_BUFFER_DYNAMIC
+ */
+class UniformRingBuffer {
+public:
+	UniformRingBuffer(Device& device, VkDeviceSize frame_size, uint32_t frames);
+	UniformRingBuffer(const UniformRingBuffer&) = delete;
+
+	static VkDeviceSize frame_size_for(const Device& device, VkDeviceSize element_size, uint32_t element_count);
+
+	void begin_frame(uint32_t frame);
+	uint32_t allocate(VkDeviceSize size);
+	uint32_t push(const void* data, VkDeviceSize size);
+
+	template <class T>
+	uint32_t push(const T& data) {
+		return push(static_cast<const void*>(&data), sizeof(T));
+	}
+
+	void flush();
+
+	VkDeviceSize aligned_size(VkDeviceSize size) const;
+	boost::ptr_vector<Buffer>* get_buffers();
+
+	const VkDeviceSize frame_size;
+
+private:
+	Device& device;
+	VkDeviceSize alignment;
+	boost::ptr_vector<Buffer> buffers{};
+	uint32_t current_frame = 0;
+	VkDeviceSize head = 0;
+
+	static VkDeviceSize get_alignment(const Device& device);
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <string>
+#include <optional>
+#include <set>
+#include <cstdint>
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "ResourcePool.h"
+#include "Queue.h"
+
+class CommandPool;
+class CommandBuffer;
+
+/**
+ * Identifies an upload. Uploads complete in the order they were requested, so a ticket is complete
+ * once every upload up to and including it has finished on the GPU
+ */
+using UploadTicket = uint64_t;
+
+/**
+ * Copies data into device local buffers and images through a single persistently mapped staging ring.
+ * Uploads are queued, recorded together into one command buffer and submitted, then tracked by the
+ * queue's timeline value so callers never wait on the queue. update() should be called once a frame to submit queued uploads
+ * (up to a byte budget) and retire finished batches.
+ *
+ * Uploads are recorded from a pool on the transfer family, so on GPUs with a dedicated transfer family they run
+ * on the copy engine alongside rendering. Destinations are then released to the graphics family, and acquire()
+ * must be recorded on the graphics queue before anything uploaded is used, with the graphics submit waiting on
+ * the TimelineWait it returns. Once a buffer has been handed to the graphics family, later uploads into it must
+ * write the whole buffer, as the transfer family doesn't own the rest of its contents
+ */
+class UploadManager {
+public:
+	static constexpr VkDeviceSize default_staging_size = 32ull * 1024 * 1024;
+	// Returned for data written directly, which is complete as soon as it's returned
+	static constexpr UploadTicket immediate_ticket = 0;
+
+	UploadManager(Device& device, CommandPool& command_pool, Queue& queue, VkDeviceSize staging_size = default_staging_size);
+	UploadManager(const UploadManager&) = delete;
+	~UploadManager();
+
+	template <class T>
+	UploadTicket upload_buffer(Buffer& destination, const std::vector<T>& data, VkDeviceSize destination_offset = 0) {
+		return upload_buffer(destination, static_cast<const void*>(data.data()), sizeof(data[0]) * data.size(), destination_offset);
+	}
+
+	UploadTicket upload_buffer(Buffer& destination, const void* data, VkDeviceSize data_size, VkDeviceSize destination_offset = 0);
+
+	template <class T>
+	std::pair<Handle<Buffer>, UploadTicket> create_buffer(const std::vector<T>& data, VkBufferUsageFlags buffer_usage) {
+		return create_buffer(static_cast<const void*>(data.data()), sizeof(data[0]) * data.size(), buffer_usage);
+	}
+
+	std::pair<Handle<Buffer>, UploadTicket> create_buffer(const void* data, VkDeviceSize data_size, VkBufferUsageFlags buffer_usage);
+	UploadTicket upload_image(Image& destination, VkFormat format, const void* data, VkDeviceSize data_size, uint32_t width, uint32_t height);
+	std::pair<Handle<Image>, UploadTicket> load_image(const std::string& image_path, VkFormat format);
+
+	void update(VkDeviceSize byte_budget = UINT64_MAX);
+	void flush();
+	void wait_idle();
+	std::optional<TimelineWait> acquire(CommandBuffer& graphics_command_buffer);
+	void cancel(const Buffer& buffer);
+	void cancel(const Image& image);
+
+	bool is_complete(UploadTicket ticket) const;
+	bool is_idle() const;
+	bool transfers_ownership() const;
+
+	const VkDeviceSize staging_size;
+
+private:
+	struct PendingUpload {
+		UploadTicket ticket;
+		Buffer* source;
+		std::unique_ptr<Buffer> oversize_source;
+		VkDeviceSize source_offset;
+		VkDeviceSize size;
+		VkDeviceSize staging_end;
+
+		Buffer* destination_buffer = nullptr;
+		VkDeviceSize destination_offset = 0;
+
+		Image* destination_image = nullptr;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	struct ImageHandoff {
+		Image* image;
+		VkImageLayout old_layout;
+	};
+
+	struct Batch {
+		CommandBuffer* command_buffer;
+		uint64_t timeline_value;
+		std::vector<std::unique_ptr<Buffer>> oversize_sources;
+		// Released to the graphics family by this batch
+		std::vector<Buffer*> released_buffers;
+		std::vector<ImageHandoff> released_images;
+		UploadTicket last_ticket;
+		VkDeviceSize staging_end;
+	};
+
+	Device& device;
+	CommandPool& command_pool;
+	Queue& queue;
+	uint32_t graphics_family;
+
+	std::unique_ptr<Buffer> staging_buffer;
+	VkDeviceSize staging_alignment;
+	VkDeviceSize head = 0;
+	VkDeviceSize tail = 0;
+
+	std::deque<PendingUpload> pending;
+	std::deque<Batch> batches;
+	std::vector<CommandBuffer*> free_command_buffers;
+
+	// From finished batches, waiting to be acquired on the graphics queue
+	std::vector<Buffer*> acquirable_buffers;
+	std::vector<ImageHandoff> acquirable_images;
+	// Timeline value of the last batch finished since acquire() last ran, 0 if none has
+	uint64_t acquirable_value = 0;
+	// Handed to the graphics family by an upload, so only whole writes are allowed from here on
+	std::set<const Buffer*> graphics_owned_buffers;
+
+	UploadTicket next_ticket = 1;
+	UploadTicket completed_ticket = 0;
+
+	PendingUpload& stage(const void* data, VkDeviceSize data_size);
+	std::optional<VkDeviceSize> allocate_staging(VkDeviceSize size);
+	void submit_pending(VkDeviceSize byte_budget);
+	void retire_batches(bool wait_for_oldest);
+};
@@ -4,18 +4,22 @@
 
 #include "Application.h"
 #include "Semaphore.h"
-#include "Fence.h"
 #include "GeometryRenderPass.h"
+#include "PostProcessRenderPass.h"
+#include "ComputeScheduler.h"
+#include "ParallelRecorder.h"
 
 #define FRAMES_IN_FLIGHT 2
 
 class Vulkus3D : public Application {
 public:
 	struct Frame {
-		CommandBuffer& command_buffer;
-		std::unique_ptr<Semaphore> image_available;
-		std::unique_ptr<Semaphore> render_finished;
-		std::unique_ptr<Fence> image_in_flight;
+		// Transient, and reset as a whole once the frame's last submit has finished
+		std::unique_ptr<CommandPool> command_pool;
+		Semaphore& image_available;
+		Semaphore& render_finished;
+		// Graphics timeline value of the frame's last submit
+		uint64_t timeline_value = 0;
 	};
 
 	static inline const std::string name = "Vulkus3D";
@@ -32,6 +36,11 @@ public:
 private:
 	uint32_t current_frame = 0;
 	std::array<std::unique_ptr<Frame>, FRAMES_IN_FLIGHT> frames;
+	std::unique_ptr<RenderGraph> graph;
+	GraphImage backbuffer;
 	std::unique_ptr<GeometryRenderPass> render_pass;
+	std::unique_ptr<PostProcessRenderPass> post_process;
+	std::unique_ptr<ComputeScheduler> compute_scheduler;
+	std::unique_ptr<ParallelRecorder> parallel_recorder;
 };
 
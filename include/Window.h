@@ -5,7 +5,7 @@
 
 class Window {
 public:
-	Window(std::string name, int width = 800, int height = 600, bool resizable = true);
+	Window(std::string name, int width = 800, int height = 600, bool resizable = true, bool visible = true);
 	~Window();
 	bool should_close();
 	GLFWwindow* get() const;
@@ -8,7 +8,7 @@ spirv_path = shader_path + "spir-v\\"
 
 def is_glsl(file):
 	extension = file.rsplit('.', 1)[-1]
-	return isfile(join(glsl_path, file)) and extension in {"frag", "vert", "glsl"}
+	return isfile(join(glsl_path, file)) and extension in {"frag", "vert", "comp", "glsl"}
 
 return_code = 0
 
@@ -0,0 +1,182 @@
+#include "AllocationTracker.h"
+
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <array>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef ALLOCATION_TEST
+namespace {
+	struct Site {
+		const char* name;
+		uint64_t allocations;
+		uint64_t bytes;
+	};
+
+	constexpr size_t max_sites = 64;
+	const char* const untracked_site = "(untracked)";
+
+	// Nothing here may allocate, as it's used from inside operator new
+	std::atomic<bool> enabled = false;
+	std::mutex mutex;
+	std::array<Site, max_sites> sites;
+	size_t site_count = 0;
+	uint64_t total_allocations = 0;
+	uint64_t total_bytes = 0;
+
+	thread_local const char* current_site = nullptr;
+	// Set while recording so anything the bookkeeping does isn't counted
+	thread_local bool recording = false;
+
+	void* allocate(size_t size) {
+		AllocationTracker::record_allocation(size);
+		void* memory = std::malloc(size == 0 ? 1 : size);
+		if (memory == nullptr) throw std::bad_alloc();
+		return memory;
+	}
+
+	void* allocate_aligned(size_t size, size_t alignment) {
+		AllocationTracker::record_allocation(size);
+#ifdef _MSC_VER
+		void* memory = _aligned_malloc(size == 0 ? 1 : size, alignment);
+#else
+		void* memory = std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+		if (memory == nullptr) throw std::bad_alloc();
+		return memory;
+	}
+
+	void free_aligned(void* memory) {
+#ifdef _MSC_VER
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+void AllocationTracker::start() {
+	std::lock_guard<std::mutex> lock(mutex);
+	site_count = 0;
+	total_allocations = 0;
+	total_bytes = 0;
+	enabled = true;
+}
+
+AllocationTracker::Report AllocationTracker::stop() {
+	enabled = false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Report report{};
+	report.allocations = total_allocations;
+	report.bytes = total_bytes;
+	for (size_t i = 0; i < site_count; i++) {
+		report.sites.push_back({ sites[i].name, sites[i].allocations, sites[i].bytes });
+	}
+	std::sort(report.sites.begin(), report.sites.end(), [](const SiteCount& a, const SiteCount& b) {
+		return a.allocations > b.allocations;
+	});
+	return report;
+}
+
+bool AllocationTracker::is_enabled() {
+	return enabled;
+}
+
+void AllocationTracker::record_allocation(size_t size) {
+	if (!enabled || recording) return;
+	recording = true;
+
+	const char* name = current_site != nullptr ? current_site : untracked_site;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		total_allocations++;
+		total_bytes += size;
+
+		// Sites are string literals, so the same site always has the same pointer
+		size_t i = 0;
+		while (i < site_count && sites[i].name != name) i++;
+		if (i == site_count && site_count < max_sites) {
+			sites[site_count++] = { name, 0, 0 };
+		}
+		if (i < site_count) {
+			sites[i].allocations++;
+			sites[i].bytes += size;
+		}
+	}
+
+	recording = false;
+}
+
+AllocationSite::AllocationSite(const char* name) : previous(current_site) {
+	current_site = name;
+}
+
+AllocationSite::~AllocationSite() {
+	current_site = previous;
+}
+
+const char* AllocationSite::current() {
+	return current_site;
+}
+
+// Replacing these is enough to see every allocation, as the array and nothrow forms call them by default
+void* operator new(size_t size) {
+	return allocate(size);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+	return allocate_aligned(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+	free_aligned(memory);
+}
+
+// The sized and array forms are replaced too so they can't be paired with a library delete that never saw our allocation
+void operator delete[](void* memory) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	operator delete(memory);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept {
+	operator delete(memory, alignment);
+}
+#else
+// Nothing is replaced, so there's nothing to count
+void AllocationTracker::start() {
+	throw std::runtime_error("Allocations are only tracked with ALLOCATION_TEST defined");
+}
+
+AllocationTracker::Report AllocationTracker::stop() {
+	return {};
+}
+
+bool AllocationTracker::is_enabled() {
+	return false;
+}
+
+void AllocationTracker::record_allocation(size_t) {}
+#endif
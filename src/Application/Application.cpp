@@ -2,6 +2,9 @@
 
 #include "Logger.h"
 #include "SubpassDependency.h"
+#include "MemoryAllocator.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
 
 Application::Application(Instance& instance, Device& device, Window& window, Surface& surface, Settings& settings) {
     this->instance = &instance;
@@ -19,14 +22,23 @@ void Application::prepare() {
     swap_chain = std::make_unique<SwapChain>(*device, *window, *surface, settings);
 
     command_pool = std::make_unique<CommandPool>(*device);
+    // Uploads run on the transfer family, which is the copy engine where the GPU has one
+    transfer_command_pool = std::make_unique<CommandPool>(*device, TRANSFER);
+    upload_manager = std::make_unique<UploadManager>(*device, *transfer_command_pool, *device->queues.at(TRANSFER));
+    // Copies on the graphics queue so they're ordered after the frames sampling the moved images
+    defragmenter = std::make_unique<Defragmenter>(*device, *command_pool, *device->queues.at(GRAPHICS), frame_submits, *upload_manager);
 }
 
 void Application::update() {
-
+    HostAllocator::get().begin_frame();
+    device->get_deletion_queue().release();
+    upload_manager->update(upload_bytes_per_frame);
+    defragmenter->update();
 }
 
 void Application::on_close() {
-
+    Logger::log("Memory usage: " + device->get_allocator().get_statistics().to_json(), Logger::VERBOSE);
+    Logger::log("Host memory usage: " + HostAllocator::get().get_statistics().to_json(), Logger::VERBOSE);
 }
 
 void Application::recreate_swapchain() {
@@ -38,8 +50,7 @@ void Application::recreate_swapchain() {
         glfwWaitEvents();
     }
 
-    device->wait_idle();
-
-    swap_chain.reset();
-    swap_chain = std::make_unique<SwapChain>(*device, *window, *surface, settings);
+    // No need to wait for the device - the old swapchain's resources go on the deletion queue until no frame uses them
+    auto new_swap_chain = std::make_unique<SwapChain>(*device, *window, *surface, settings, swap_chain.get());
+    swap_chain = std::move(new_swap_chain);
 }
\ No newline at end of file
@@ -33,6 +33,10 @@ VkDescriptorType get_access_type(VkDescriptorType descriptor_type) {
         return DescriptorType::UniformBuffer;
     case DescriptorType::CombinedImageSampler:
         return DescriptorType::CombinedImageSampler;
+    case DescriptorType::UniformBufferDynamic:
+        return DescriptorType::UniformBufferDynamic;
+    case DescriptorType::StorageBuffer:
+        return DescriptorType::StorageBuffer;
     default:
         throw std::runtime_error("Unknown descriptor type with index " + std::to_string(descriptor_type));
     }
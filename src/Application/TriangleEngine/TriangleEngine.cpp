@@ -1,6 +1,9 @@
 #include "TriangleEngine.h"
 
 #include "Logger.h"
+#include "FrameArena.h"
+#include "SyncPool.h"
+#include "AllocationTracker.h"
 
 TriangleEngine::TriangleEngine(Instance& instance, Device& device, Window& window, Surface& surface, Settings& settings) :
 	Application(instance, device, window, surface, settings)
@@ -14,48 +17,59 @@ TriangleEngine::~TriangleEngine() {
 void TriangleEngine::prepare() {
 	Application::prepare();
 
-	Queue& transfer_queue = *device->queues.at(TRANSFER);
+	graph = std::make_unique<RenderGraph>(*device);
+	// Whatever was presented from the swapchain image before isn't needed, but it's only free once acquired
+	backbuffer = graph->import_image("Backbuffer", swap_chain->image_format, { VK_IMAGE_LAYOUT_UNDEFINED, PipelineStage::ColourAttachmentOutput, 0 });
+	graph->set_output(backbuffer, ImageState::for_layout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
 
-	render_pass = std::make_unique<TriangleRenderPass>(*device, *swap_chain);
-	render_pass->prepare_framebuffers();
-	render_pass->prepare_pipeline(*command_pool, transfer_queue);
+	render_pass = std::make_unique<TriangleRenderPass>(*device);
+	render_pass->add_to_graph(*graph, backbuffer);
+	graph->compile(swap_chain->get_extent());
+	render_pass->prepare_pipeline(*upload_manager);
 
 	for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
 		frames[i] = std::make_unique<Frame>(
-			command_pool->create_command_buffer(),
-			std::make_unique<Semaphore>(*device),
-			std::make_unique<Semaphore>(*device),
-			std::make_unique<Fence>(*device)
+			std::make_unique<CommandPool>(*device, GRAPHICS, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT),
+			device->get_sync_pool().acquire_semaphore(),
+			device->get_sync_pool().acquire_semaphore()
 		);
 	}
 }
 
 void TriangleEngine::update() {
+	AllocationSite site("TriangleEngine::update");
 	Application::update();
 
 	Frame& frame = *frames.at(current_frame);
 
-	frame.image_in_flight->wait();
-
-	CommandBuffer& command_buffer = frame.command_buffer;
 	Queue& graphics_queue = *device->queues.at(GRAPHICS);
 	Queue& present_queue = *device->queues.at(PRESENT);
-	ImageIndex image_index = swap_chain->get_next_image(*frame.image_available);
 
-	frame.image_in_flight->reset();
+	graphics_queue.wait(frame.timeline_value);
+	// Nothing from this frame's last use is needed any more
+	FrameArena::get().begin_frame(current_frame);
+	frame.command_pool->reset();
+
+	ImageIndex image_index = swap_chain->get_next_image(frame.image_available);
 
-	auto wait_semaphores = std::vector<std::pair<Semaphore*, VkPipelineStageFlags>>();
-	wait_semaphores.push_back(std::pair(frame.image_available.get(), PipelineStage::ColourAttachmentOutput));
+	auto wait_semaphores = ArenaVector<std::pair<Semaphore*, VkPipelineStageFlags>>();
+	wait_semaphores.push_back(std::pair(&frame.image_available, PipelineStage::ColourAttachmentOutput));
 
-	auto signal_semaphores = std::vector<Semaphore*>();
-	signal_semaphores.push_back(frame.render_finished.get());
+	auto signal_semaphores = ArenaVector<Semaphore*>();
+	signal_semaphores.push_back(&frame.render_finished);
 
-	command_buffer.reset();
-	command_buffer.start_recording();
-	render_pass->record_commands(command_buffer, image_index);
+	// Recorded fresh every frame, so it's only submitted once
+	CommandBuffer& command_buffer = frame.command_pool->next_command_buffer();
+	command_buffer.start_recording(true);
+	auto timeline_waits = ArenaVector<TimelineWait>();
+	std::optional<TimelineWait> upload_wait = upload_manager->acquire(command_buffer);
+	if (upload_wait.has_value()) timeline_waits.push_back(upload_wait.value());
+	graph->set_image(backbuffer, device->get_resources().images.get(swap_chain->images.at(image_index)));
+	graph->execute(command_buffer);
 	command_buffer.stop_recording();
 
-	graphics_queue.submit(command_buffer, wait_semaphores, signal_semaphores, frame.image_in_flight.get());
+	frame_submits.add(command_buffer, wait_semaphores, signal_semaphores, timeline_waits);
+	frame.timeline_value = graphics_queue.submit(frame_submits);
 
 	present_queue.present(*swap_chain, image_index, signal_semaphores);
 
@@ -71,7 +85,6 @@ void TriangleEngine::on_close() {
 void TriangleEngine::recreate_swapchain() {
 	Application::recreate_swapchain();
 
-	Logger::log("Refreshing framebuffers", Logger::VERBOSE);
-	render_pass->update_swapchain(*swap_chain);
-	render_pass->prepare_framebuffers();
+	Logger::log("Resizing render graph", Logger::VERBOSE);
+	graph->resize(swap_chain->get_extent());
 }
\ No newline at end of file
@@ -3,112 +3,114 @@
 #include "Logger.h"
 #include "Image.h"
 #include "Helper.h"
+#include "AllocationTracker.h"
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <chrono>
+#include <algorithm>
 
-GeometryRenderPass::GeometryRenderPass(Device& device, SwapChain& swap_chain, std::vector<SubpassDependency> dependancies) :
-    device(device), swap_chain(&swap_chain), sampler(device)
+GeometryRenderPass::GeometryRenderPass(Device& device, uint32_t draw_count) :
+    draw_count(std::max(draw_count, instance_count)), device(device), resources(device.get_resources()), sampler(resources.samplers.create(device))
 {
-    SubpassDependency dependancy;
-    dependancy.set_src_subpass(VK_SUBPASS_EXTERNAL);
-    dependancy.set_dest_subpass(0);
-    dependancy.add_src_stage(PipelineStage::ColourAttachmentOutput | PipelineStage::EarlyFragmentTest); // Only when previous has finished writing...
-    dependancy.add_dest_stage(PipelineStage::ColourAttachmentOutput | PipelineStage::EarlyFragmentTest); // will we write the current subpass
-    dependancy.add_dest_access(PipelineAccess::ColourAttachmentWrite | PipelineAccess::DepthStencilAttachmentWrite); // Write colour and depth
-
-    attachment_descriptions = {};
-    attachment_descriptions.add_attachment(swap_chain.image_format);
-    attachment_descriptions.add_attachment(get_supported_depth_format(device.physical_device), false);
-
-    render_pass = std::make_unique<RenderPass>(device, attachment_descriptions, std::vector{ dependancy });
-    pipeline = std::make_unique<Pipeline>(device);
-    pipeline->enable_depth_test();
+    record_range = [this](CommandBuffer& command_buffer, uint32_t first, uint32_t count) { record_draws(command_buffer, first, count); };
+    pipeline = resources.pipelines.create(device);
+    resources.pipelines.get(pipeline).enable_depth_test();
+    compute_pipeline = resources.compute_pipelines.create(device);
 }
 
-void GeometryRenderPass::update_swapchain(SwapChain& swap_chain) {
-    this->swap_chain = &swap_chain;
+GeometryRenderPass::~GeometryRenderPass() {
+    resources.compute_pipelines.destroy(compute_pipeline);
+    resources.pipelines.destroy(pipeline);
+    resources.images.destroy(image);
+    resources.buffers.destroy(index_buffer);
+    resources.buffers.destroy(vertex_buffer);
+    resources.samplers.destroy(sampler);
 }
 
-void GeometryRenderPass::prepare_framebuffers() {
-    framebuffers = std::vector<std::unique_ptr<Framebuffer>>();
-    if (swap_chain->images.size() == 0) {
-        throw std::runtime_error("Render pass has no targets!");
-    }
-    VkFormat depth_format = get_supported_depth_format(device.physical_device);
-    depth_image = std::make_unique<Image>(device, depth_format, swap_chain->get_extent().width, swap_chain->get_extent().height, ImageType::DEPTH);
-    for (auto& image : swap_chain->images) {
-        std::vector<Image *> attachments{};
-        attachments.push_back(&image);
-        attachments.push_back(depth_image.get());
-        auto framebuffer = std::make_unique<Framebuffer>(device, *render_pass, attachments, *swap_chain);
-        framebuffers.push_back(std::move(framebuffer));
-    }
+/**
+ * Draws into target, with a depth buffer owned by the graph. The graph works out the render pass from this.
+ * The draws are recorded into secondary command buffers by parallel_recorder
+ */
+void GeometryRenderPass::add_to_graph(RenderGraph& graph, GraphImage target, ParallelRecorder& parallel_recorder) {
+    GraphImageDescription depth_description{};
+    depth_description.format = get_supported_depth_format(device.physical_device);
+    depth_description.image_type = ImageType::DEPTH;
+    GraphImage depth = graph.create_image("Depth", depth_description);
+
+    this->graph = &graph;
+    this->parallel_recorder = &parallel_recorder;
+    pass = &graph.add_pass("Geometry", PassType::GRAPHICS);
+    pass->write_colour(target);
+    pass->write_depth(depth);
+    pass->use_secondary_command_buffers();
+    pass->set_record([this](CommandBuffer& command_buffer) { record_commands(command_buffer); });
 }
 
-void GeometryRenderPass::create_buffers(CommandPool& setup_command_pool, Queue& transfer_queue) {
-    VkDeviceSize vertex_data_size = sizeof(vertices[0]) * vertices.size();
-    auto vertex_staging_buffer = Buffer::create_buffer(device, vertices, BufferUsage::TransferSource, MemoryProperties::HostVisible | MemoryProperties::HostCoherent);
-    vertex_buffer = Buffer::create_empty_buffer(device, vertex_data_size, BufferUsage::TransferDestination | BufferUsage::Vertex, MemoryProperties::DeviceLocal);
-
-    VkDeviceSize index_data_size = sizeof(indices[0]) * indices.size();
-    auto index_staging_buffer = Buffer::create_buffer(device, indices, BufferUsage::TransferSource, MemoryProperties::HostVisible | MemoryProperties::HostCoherent);
-    index_buffer = Buffer::create_empty_buffer(device, index_data_size, BufferUsage::TransferDestination | BufferUsage::Index, MemoryProperties::DeviceLocal);
-
-    VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
-    auto [texture_buffer, width, height] = Buffer::create_buffer_from_image(device, "assets/textures/texture.jpg", BufferUsage::TransferSource, MemoryProperties::HostVisible | MemoryProperties::HostCoherent);
-    image = std::make_unique<Image>(device, format, width, height);
-
-    VkFormat depth_format = get_supported_depth_format(device.physical_device);
-    depth_image = std::make_unique<Image>(device, depth_format, swap_chain->get_extent().width, swap_chain->get_extent().height, ImageType::DEPTH);
-    
-    CommandBuffer command_buffer(device, setup_command_pool);
-    command_buffer.start_recording(true);
-
-    // Copy vertex data
-    command_buffer.cmd_copy_buffer(*vertex_staging_buffer, *vertex_buffer, vertex_data_size);
-
-    // Copy index data
-    command_buffer.cmd_copy_buffer(*index_staging_buffer, *index_buffer, index_data_size);
-
-    // Transition image
-    command_buffer.cmd_image_pipeline_barrier(*image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    command_buffer.cmd_copy_buffer_to_image(*texture_buffer, *image, width, height);
-    command_buffer.cmd_image_pipeline_barrier(*image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    // Transition depth
-    command_buffer.cmd_image_pipeline_barrier(*depth_image, depth_format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
-    command_buffer.stop_recording();
-
-    transfer_queue.submit(command_buffer);
-    transfer_queue.wait_idle();
+void GeometryRenderPass::create_buffers(UploadManager& upload_manager) {
+    // Uploads complete in order, so the last ticket tells us when everything has arrived
+    this->upload_manager = &upload_manager;
+    vertex_buffer = upload_manager.create_buffer(vertices, BufferUsage::Vertex).first;
+    index_buffer = upload_manager.create_buffer(indices, BufferUsage::Index).first;
+    std::tie(image, upload_ticket) = upload_manager.load_image("assets/textures/texture.jpg", VK_FORMAT_R8G8B8A8_SRGB);
 }
 
 void GeometryRenderPass::prepare_pipeline() {
     Shader vertex_shader(device, "Vertices_vert.spv");
     Shader fragment_shader(device, "Vertices_frag.spv");
+    Shader compute_shader(device, "Instances_comp.spv");
+
+    resources.pipelines.get(pipeline).create(vertex_shader, fragment_shader, graph->get_render_pass(*pass));
+    resources.compute_pipelines.get(compute_pipeline).create(compute_shader);
+}
+
+/**
+ * Called by the render graph inside its render pass, which only takes secondary command buffers
+ */
+void GeometryRenderPass::record_commands(CommandBuffer& command_buffer) {
+    AllocationSite site("GeometryRenderPass::record_commands");
+    // Geometry and texture stream in through the upload manager, so just clear until they've arrived
+    if (!upload_manager->is_complete(upload_ticket)) return;
 
-    pipeline->create(vertex_shader, fragment_shader, *render_pass);
+    parallel_recorder->record(command_buffer, draw_count, record_range);
 }
 
-void GeometryRenderPass::record_commands(CommandBuffer& command_buffer, uint32_t current_framebuffer, uint32_t current_frame) {
-    command_buffer.cmd_begin_render_pass(*render_pass, *framebuffers.at(current_framebuffer), attachment_descriptions);
-    command_buffer.cmd_bind_pipeline(*pipeline);
-    command_buffer.cmd_bind_vertex_buffer(*vertex_buffer);
-    command_buffer.cmd_bind_index_buffer(*index_buffer, IndexType::UInt16);
-    command_buffer.cmd_bind_descriptor_set(*descriptor_pool, *pipeline, current_frame);
+/**
+ * Records draws [first, first + count) into a secondary command buffer. Runs on the parallel recorder's threads,
+ * so it only reads state set up before the frame's recording started
+ */
+void GeometryRenderPass::record_draws(CommandBuffer& command_buffer, uint32_t first, uint32_t count) {
+    Pipeline& pipeline = resources.pipelines.get(this->pipeline);
+    command_buffer.cmd_bind_pipeline(pipeline);
+    command_buffer.cmd_bind_vertex_buffer(resources.buffers.get(vertex_buffer));
+    command_buffer.cmd_bind_index_buffer(resources.buffers.get(index_buffer), IndexType::UInt16);
     command_buffer.cmd_set_scissor();
     command_buffer.cmd_set_viewport();
-    command_buffer.cmd_draw_indexed(indices.size());
-    command_buffer.cmd_end_render_pass();
+
+    for (uint32_t i = first; i < first + count; i++) {
+        uint32_t instance = i % instance_count;
+        command_buffer.cmd_bind_descriptor_set(*descriptor_pool, pipeline, current_frame, { instance * instance_stride });
+        command_buffer.cmd_draw_indexed(indices.size());
+    }
+}
+
+/**
+ * Called between the compute scheduler's begin and submit. Spreads this frame's transformations across the
+ * instances, then hands them to the vertex shader
+ */
+void GeometryRenderPass::record_compute(ComputeScheduler& compute_scheduler, CommandBuffer& command_buffer) {
+    ComputePipeline& compute_pipeline = resources.compute_pipelines.get(this->compute_pipeline);
+    command_buffer.cmd_bind_pipeline(compute_pipeline);
+    command_buffer.cmd_bind_descriptor_set(*compute_descriptor_pool, compute_pipeline, current_frame, { transformations_offset });
+    command_buffer.cmd_dispatch((instance_count + instances_per_workgroup - 1) / instances_per_workgroup);
+
+    compute_scheduler.release_buffer(instance_buffers[current_frame], PipelineStage::ComputeShader, PipelineAccess::ShaderWrite, PipelineStage::VertexShader, PipelineAccess::UniformRead);
 }
 
 void GeometryRenderPass::setup_descriptor_sets(uint32_t num_descriptor_sets) {
-    descriptor_sets.emplace_back(ShaderStage::Vertex, DescriptorType::Sampler, sizeof(Transformations));
+    descriptor_sets.emplace_back(ShaderStage::Vertex, DescriptorType::UniformBufferDynamic, sizeof(Transformations));
     descriptor_sets.emplace_back(ShaderStage::Fragment, DescriptorType::CombinedImageSampler, 0);
 
     std::vector<AttributeEntry> attribute_entries;
@@ -117,33 +119,53 @@ void GeometryRenderPass::setup_descriptor_sets(uint32_t num_descriptor_sets) {
     attribute_entries.emplace_back(VK_FORMAT_R32G32_SFLOAT, 2 * sizeof(float));
     AttributeDescriptor attribute_descriptor(attribute_entries);
 
-    pipeline->set_attribute_descriptor(attribute_descriptor);
+    Pipeline& pipeline = resources.pipelines.get(this->pipeline);
+    pipeline.set_attribute_descriptor(attribute_descriptor);
     for (uint32_t i = 0; i < descriptor_sets.size(); i++) {
         DescriptorSetInfo descriptor_set = descriptor_sets[i];
-        pipeline->add_descriptor_set_binding(i, descriptor_set.shader_stage, get_access_type(descriptor_set.descriptor_type));
+        pipeline.add_descriptor_set_binding(i, descriptor_set.shader_stage, get_access_type(descriptor_set.descriptor_type));
     }
 
-    for (size_t i = 0; i < num_descriptor_sets; i++) {
-        VkDeviceSize buffer_size = sizeof(Transformations);
-        descriptor_set_buffers.push_back(Buffer::create_empty_buffer(device, buffer_size, BufferUsage::Uniform, MemoryProperties::HostVisible | MemoryProperties::HostCoherent, LocalMemory::Persistent));
+    compute_descriptor_sets.emplace_back(ShaderStage::Compute, DescriptorType::UniformBufferDynamic, sizeof(Transformations));
+    compute_descriptor_sets.emplace_back(ShaderStage::Compute, DescriptorType::StorageBuffer, instance_count * instance_stride);
+
+    ComputePipeline& compute_pipeline = resources.compute_pipelines.get(this->compute_pipeline);
+    for (uint32_t i = 0; i < compute_descriptor_sets.size(); i++) {
+        DescriptorSetInfo descriptor_set = compute_descriptor_sets[i];
+        compute_pipeline.add_descriptor_set_binding(i, descriptor_set.shader_stage, get_access_type(descriptor_set.descriptor_type));
+    }
+
+    VkDeviceSize frame_size = UniformRingBuffer::frame_size_for(device, sizeof(Transformations), 1);
+    uniform_buffer = std::make_unique<UniformRingBuffer>(device, frame_size, num_descriptor_sets);
+    for (uint32_t i = 0; i < num_descriptor_sets; i++) {
+        instance_buffers.push_back(Buffer::create_empty_buffer(device, instance_count * instance_stride, BufferUsage::Uniform | BufferUsage::Storage, MemoryProperties::DeviceLocal));
     }
 }
 
 void GeometryRenderPass::prepare_descriptor_sets(uint32_t num_descriptor_sets) {
-    if (image == nullptr) {
+    if (!resources.images.is_valid(image)) {
         throw std::runtime_error("Image hasn't been setup yet");
     }
 
     std::vector<DescriptorPool::DescriptorAccess> descriptor_accesses{};
-    descriptor_accesses.push_back(&descriptor_set_buffers);
-    descriptor_accesses.push_back(DescriptorPool::ImageSampler(image->get_view(), sampler.get()));
+    descriptor_accesses.push_back(&instance_buffers);
+    descriptor_accesses.push_back(DescriptorPool::ImageSampler(&resources.images.get(image), resources.samplers.get(sampler).get()));
 
     descriptor_pool = std::make_unique<DescriptorPool>(device, descriptor_sets, num_descriptor_sets);
-    descriptor_pool->allocate_descriptor_set(pipeline->get_descriptor_set_layout());
+    descriptor_pool->allocate_descriptor_set(resources.pipelines.get(pipeline).get_descriptor_set_layout());
     descriptor_pool->update_descriptor_sets(descriptor_accesses);
+
+    std::vector<DescriptorPool::DescriptorAccess> compute_descriptor_accesses{};
+    compute_descriptor_accesses.push_back(uniform_buffer->get_buffers());
+    compute_descriptor_accesses.push_back(&instance_buffers);
+
+    compute_descriptor_pool = std::make_unique<DescriptorPool>(device, compute_descriptor_sets, num_descriptor_sets);
+    compute_descriptor_pool->allocate_descriptor_set(resources.compute_pipelines.get(compute_pipeline).get_descriptor_set_layout());
+    compute_descriptor_pool->update_descriptor_sets(compute_descriptor_accesses);
 }
 
 void GeometryRenderPass::update_descriptor_sets(uint32_t screen_width, uint32_t screen_height, uint32_t buffer_index) {
+    AllocationSite site("GeometryRenderPass::update_descriptor_sets");
     static auto start_time = std::chrono::high_resolution_clock::now();
 
     auto current_time = std::chrono::high_resolution_clock::now();
@@ -155,14 +177,22 @@ void GeometryRenderPass::update_descriptor_sets(uint32_t screen_width, uint32_t
     const glm::vec3 centre = glm::vec3(0.0f, 0.0f, 0.0f);
 
     float rotation = time * glm::radians(90.0f);
-    glm::vec3 camera_position = glm::vec3(2.0f, 2.0f, 2.0f);
+    // Far enough back to see the whole grid of instances
+    glm::vec3 camera_position = glm::vec3(6.0f, 6.0f, 6.0f);
     float fov = glm::radians(45.0f);
 
     Transformations transformations{};
     transformations.model = glm::rotate(identity, rotation, back);
     transformations.view = glm::lookAt(camera_position, centre, up);
-    transformations.projection = glm::perspective(fov, screen_width / (float) screen_height, 0.1f, 10.0f);
+    transformations.projection = glm::perspective(fov, screen_width / (float) screen_height, 0.1f, 25.0f);
     transformations.projection[1][1] *= -1; // Y-coordinate is inverted compared to OpenGL
 
-    descriptor_set_buffers.at(buffer_index).fill_buffer(&transformations, sizeof(Transformations));
+    // Picks up any textures or instance buffers the defragmenter has moved since this frame's sets were last used
+    descriptor_pool->refresh_descriptor_set(buffer_index);
+    compute_descriptor_pool->refresh_descriptor_set(buffer_index);
+    current_frame = buffer_index;
+
+    uniform_buffer->begin_frame(buffer_index);
+    transformations_offset = uniform_buffer->push(transformations);
+    uniform_buffer->flush();
 }
\ No newline at end of file
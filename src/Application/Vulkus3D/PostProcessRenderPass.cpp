@@ -0,0 +1,116 @@
+#include "PostProcessRenderPass.h"
+
+#include "Logger.h"
+#include "Image.h"
+#include "Helper.h"
+#include "AllocationTracker.h"
+
+PostProcessRenderPass::PostProcessRenderPass(Device& device) :
+    device(device), resources(device.get_resources()), sampler(resources.samplers.create(device, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE))
+{
+    for (Step& step : steps) {
+        step.pipeline = resources.pipelines.create(device);
+    }
+}
+
+PostProcessRenderPass::~PostProcessRenderPass() {
+    for (Step& step : steps) {
+        resources.pipelines.destroy(step.pipeline);
+    }
+    resources.samplers.destroy(sampler);
+}
+
+/**
+ * Blurs source horizontally then vertically, then composites the result into target. The intermediate images
+ * are owned by the graph, in the given format
+ */
+void PostProcessRenderPass::add_to_graph(RenderGraph& graph, GraphImage source, GraphImage target, VkFormat format) {
+    GraphImageDescription description{};
+    description.format = format;
+    GraphImage blurred_horizontally = graph.create_image("Blurred horizontally", description);
+    blurred = graph.create_image("Blurred", description);
+
+    const std::array<std::string, 3> names = { "Blur horizontal", "Blur vertical", "Composite" };
+    const std::array<std::string, 3> fragment_shaders = { "BlurHorizontal_frag.spv", "BlurVertical_frag.spv", "Composite_frag.spv" };
+    const std::array<GraphImage, 3> inputs = { source, blurred_horizontally, blurred };
+    const std::array<GraphImage, 3> outputs = { blurred_horizontally, blurred, target };
+
+    this->graph = &graph;
+    for (uint32_t i = 0; i < steps.size(); i++) {
+        Step& step = steps[i];
+        step.fragment_shader = fragment_shaders[i];
+        step.input = inputs[i];
+        step.pass = &graph.add_pass(names[i], PassType::GRAPHICS);
+        step.pass->read_texture(inputs[i]);
+        step.pass->write_colour(outputs[i]);
+        step.pass->set_record([this, &step](CommandBuffer& command_buffer) { record_commands(command_buffer, step); });
+    }
+}
+
+void PostProcessRenderPass::prepare_pipelines() {
+    Shader vertex_shader(device, "Fullscreen_vert.spv");
+
+    for (Step& step : steps) {
+        step.descriptor_sets.emplace_back(ShaderStage::Fragment, DescriptorType::CombinedImageSampler, 0);
+
+        Pipeline& pipeline = resources.pipelines.get(step.pipeline);
+        pipeline.add_descriptor_set_binding(0, ShaderStage::Fragment, get_access_type(DescriptorType::CombinedImageSampler));
+
+        Shader fragment_shader(device, step.fragment_shader);
+        pipeline.create(vertex_shader, fragment_shader, graph->get_render_pass(*step.pass));
+    }
+}
+
+void PostProcessRenderPass::prepare_descriptor_sets(uint32_t num_descriptor_sets) {
+    for (Step& step : steps) {
+        std::vector<DescriptorPool::DescriptorAccess> descriptor_accesses = get_descriptor_accesses(step);
+
+        step.descriptor_pool = std::make_unique<DescriptorPool>(device, step.descriptor_sets, num_descriptor_sets);
+        step.descriptor_pool->allocate_descriptor_set(resources.pipelines.get(step.pipeline).get_descriptor_set_layout());
+        step.descriptor_pool->update_descriptor_sets(descriptor_accesses);
+    }
+}
+
+/**
+ * Called once the frame using buffer_index has finished, so its descriptor sets can be rewritten
+ */
+void PostProcessRenderPass::update_descriptor_sets(uint32_t buffer_index) {
+    current_frame = buffer_index;
+    for (Step& step : steps) {
+        step.descriptor_pool->refresh_descriptor_set(buffer_index);
+    }
+}
+
+/**
+ * The graph recreates its images on resize, so each frame's descriptor sets pick up the new ones when next refreshed
+ */
+void PostProcessRenderPass::on_resize() {
+    for (Step& step : steps) {
+        std::vector<DescriptorPool::DescriptorAccess> descriptor_accesses = get_descriptor_accesses(step);
+        step.descriptor_pool->replace_descriptor_accesses(descriptor_accesses);
+    }
+}
+
+GraphImage PostProcessRenderPass::get_blurred() const {
+    return blurred;
+}
+
+/**
+ * Called by the render graph inside the step's render pass
+ */
+void PostProcessRenderPass::record_commands(CommandBuffer& command_buffer, Step& step) {
+    AllocationSite site("PostProcessRenderPass::record_commands");
+    Pipeline& pipeline = resources.pipelines.get(step.pipeline);
+    command_buffer.cmd_bind_pipeline(pipeline);
+    command_buffer.cmd_bind_descriptor_set(*step.descriptor_pool, pipeline, current_frame);
+    command_buffer.cmd_set_scissor();
+    command_buffer.cmd_set_viewport();
+    // Fullscreen_vert makes a triangle covering the screen out of the vertex indices alone
+    command_buffer.cmd_draw(3);
+}
+
+std::vector<DescriptorPool::DescriptorAccess> PostProcessRenderPass::get_descriptor_accesses(const Step& step) const {
+    std::vector<DescriptorPool::DescriptorAccess> descriptor_accesses{};
+    descriptor_accesses.push_back(DescriptorPool::ImageSampler(&graph->get_image(step.input), resources.samplers.get(sampler).get()));
+    return descriptor_accesses;
+}
@@ -1,6 +1,9 @@
 #include "Vulkus3D.h"
 
 #include "Logger.h"
+#include "FrameArena.h"
+#include "SyncPool.h"
+#include "AllocationTracker.h"
 
 Vulkus3D::Vulkus3D(Instance& instance, Device& device, Window& window, Surface& surface, Settings& settings) :
 	Application(instance, device, window, surface, settings)
@@ -14,53 +17,84 @@ Vulkus3D::~Vulkus3D() {
 void Vulkus3D::prepare() {
 	Application::prepare();
 
-	Queue& transfer_queue = *device->queues.at(TRANSFER);
+	graph = std::make_unique<RenderGraph>(*device);
+	// Whatever was presented from the swapchain image before isn't needed, but it's only free once acquired
+	backbuffer = graph->import_image("Backbuffer", swap_chain->image_format, { VK_IMAGE_LAYOUT_UNDEFINED, PipelineStage::ColourAttachmentOutput, 0 });
+	graph->set_output(backbuffer, ImageState::for_layout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR));
+
+	// Drawn into an image of the graph's own, which post processing then composites into the backbuffer
+	GraphImage scene = graph->create_image("Scene", { swap_chain->image_format });
+
+	parallel_recorder = std::make_unique<ParallelRecorder>(*device, FRAMES_IN_FLIGHT);
+	render_pass = std::make_unique<GeometryRenderPass>(*device, settings.stress_draw_count);
+	render_pass->create_buffers(*upload_manager);
+	render_pass->add_to_graph(*graph, scene, *parallel_recorder);
+	post_process = std::make_unique<PostProcessRenderPass>(*device);
+	post_process->add_to_graph(*graph, scene, backbuffer, swap_chain->image_format);
+	graph->compile(swap_chain->get_extent());
+
+	if (!graph->shares_memory(scene, post_process->get_blurred())) {
+		Logger::log("Scene and Blurred are never in use at the same time, but the render graph didn't alias them", Logger::WARN);
+	}
 
-	render_pass = std::make_unique<GeometryRenderPass>(*device, *swap_chain);
-	render_pass->create_buffers(*command_pool, transfer_queue);
-	render_pass->prepare_framebuffers();
 	render_pass->setup_descriptor_sets(FRAMES_IN_FLIGHT);
 	render_pass->prepare_pipeline();
 	render_pass->prepare_descriptor_sets(FRAMES_IN_FLIGHT);
+	post_process->prepare_pipelines();
+	post_process->prepare_descriptor_sets(FRAMES_IN_FLIGHT);
+	compute_scheduler = std::make_unique<ComputeScheduler>(*device, FRAMES_IN_FLIGHT);
 
 	for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
 		frames[i] = std::make_unique<Frame>(
-			command_pool->create_command_buffer(),
-			std::make_unique<Semaphore>(*device),
-			std::make_unique<Semaphore>(*device),
-			std::make_unique<Fence>(*device)
+			std::make_unique<CommandPool>(*device, GRAPHICS, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT),
+			device->get_sync_pool().acquire_semaphore(),
+			device->get_sync_pool().acquire_semaphore()
 			);
 	}
 }
 
 void Vulkus3D::update() {
+	AllocationSite site("Vulkus3D::update");
 	Application::update();
 
 	Frame& frame = *frames.at(current_frame);
 
-	frame.image_in_flight->wait();
-
-	CommandBuffer& command_buffer = frame.command_buffer;
 	Queue& graphics_queue = *device->queues.at(GRAPHICS);
 	Queue& present_queue = *device->queues.at(PRESENT);
-	ImageIndex image_index = swap_chain->get_next_image(*frame.image_available);
 
-	frame.image_in_flight->reset();
+	graphics_queue.wait(frame.timeline_value);
+	// Nothing from this frame's last use is needed any more
+	FrameArena::get().begin_frame(current_frame);
+	frame.command_pool->reset();
+	parallel_recorder->begin_frame(current_frame);
 
-	render_pass->update_descriptor_sets(swap_chain->get_extent().width, swap_chain->get_extent().height, current_frame);
-
-	auto wait_semaphores = std::vector<std::pair<Semaphore*, VkPipelineStageFlags>>();
-	wait_semaphores.push_back(std::pair(frame.image_available.get(), PipelineStage::ColourAttachmentOutput));
+	ImageIndex image_index = swap_chain->get_next_image(frame.image_available);
 
-	auto signal_semaphores = std::vector<Semaphore*>();
-	signal_semaphores.push_back(frame.render_finished.get());
-
-	command_buffer.reset();
-	command_buffer.start_recording();
-	render_pass->record_commands(command_buffer, image_index, current_frame);
+	render_pass->update_descriptor_sets(swap_chain->get_extent().width, swap_chain->get_extent().height, current_frame);
+	post_process->update_descriptor_sets(current_frame);
+
+	auto timeline_waits = ArenaVector<TimelineWait>();
+	render_pass->record_compute(*compute_scheduler, compute_scheduler->begin(current_frame));
+	timeline_waits.push_back(compute_scheduler->submit(PipelineStage::VertexShader));
+
+	auto wait_semaphores = ArenaVector<std::pair<Semaphore*, VkPipelineStageFlags>>();
+	wait_semaphores.push_back(std::pair(&frame.image_available, PipelineStage::ColourAttachmentOutput));
+
+	auto signal_semaphores = ArenaVector<Semaphore*>();
+	signal_semaphores.push_back(&frame.render_finished);
+
+	// Recorded fresh every frame, so it's only submitted once
+	CommandBuffer& command_buffer = frame.command_pool->next_command_buffer();
+	command_buffer.start_recording(true);
+	std::optional<TimelineWait> upload_wait = upload_manager->acquire(command_buffer);
+	if (upload_wait.has_value()) timeline_waits.push_back(upload_wait.value());
+	compute_scheduler->acquire(command_buffer);
+	graph->set_image(backbuffer, device->get_resources().images.get(swap_chain->images.at(image_index)));
+	graph->execute(command_buffer);
 	command_buffer.stop_recording();
 
-	graphics_queue.submit(command_buffer, wait_semaphores, signal_semaphores, frame.image_in_flight.get());
+	frame_submits.add(command_buffer, wait_semaphores, signal_semaphores, timeline_waits);
+	frame.timeline_value = graphics_queue.submit(frame_submits);
 
 	present_queue.present(*swap_chain, image_index, signal_semaphores);
 
@@ -76,7 +110,7 @@ void Vulkus3D::on_close() {
 void Vulkus3D::recreate_swapchain() {
 	Application::recreate_swapchain();
 
-	Logger::log("Refreshing framebuffers", Logger::VERBOSE);
-	render_pass->update_swapchain(*swap_chain);
-	render_pass->prepare_framebuffers();
+	Logger::log("Resizing render graph", Logger::VERBOSE);
+	graph->resize(swap_chain->get_extent());
+	post_process->on_resize();
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <set>
+#include <string>
 #include <GLFW/glfw3.h>
 
 #include "LudusVulkus.h"
@@ -15,13 +17,42 @@
 #include "TriangleEngine.h"
 #include "Vulkus3D.h"
 
-int main() {
+const uint32_t allocation_test_warmup_frames = 120;
+const uint32_t allocation_test_frames = 600;
+const uint32_t stress_test_draws = 16384;
+
+template <class App>
+void run(bool allocation_test, bool stress_test) {
+    LudusVulkus<App> ludus_vulkus;
+    if (allocation_test) {
+        ludus_vulkus.enable_allocation_test(allocation_test_warmup_frames, allocation_test_frames);
+    }
+    if (stress_test) {
+        ludus_vulkus.enable_stress_test(stress_test_draws);
+    }
+    ludus_vulkus.run();
+}
+
+/**
+ * --triangle runs the TriangleEngine instead of Vulkus3D
+ * --allocation-test checks the frame loop makes no heap allocations once warmed up, failing if it does. Only
+ * builds of the AllocationTest configuration can run it
+ * --stress has Vulkus3D record thousands of draws a frame across threads, into secondary command buffers
+ */
+int main(int argc, char* argv[]) {
+    std::set<std::string> arguments(argv + 1, argv + argc);
+    bool allocation_test = arguments.contains("--allocation-test");
+    bool stress_test = arguments.contains("--stress");
+
     // Load GLFW for future use
     glfwInit();
 
     try {
-        LudusVulkus<Vulkus3D> ludus_vulkus;
-        ludus_vulkus.run();
+        if (arguments.contains("--triangle")) {
+            run<TriangleEngine>(allocation_test, stress_test);
+        } else {
+            run<Vulkus3D>(allocation_test, stress_test);
+        }
     } catch (const std::exception& e) {
         Logger::log(e.what(), Logger::FATAL);
         return EXIT_FAILURE;
@@ -0,0 +1,182 @@
+#include "BarrierBatch.h"
+
+#include "Type.h"
+
+/**
+ * Moves every subresource in the range to state. Discarding skips keeping the contents, which lets the
+ * driver avoid a layout conversion. Reads after reads in the same layout need no barrier at all, so they
+ * only widen the tracked state for whatever next writes
+ */
+void BarrierBatch::add_image(Image& image, const ImageState& state, bool discard, uint32_t base_mip_level, uint32_t mip_level_count, uint32_t base_array_layer, uint32_t array_layer_count) {
+	uint32_t end_mip_level = mip_level_count == VK_REMAINING_MIP_LEVELS ? image.get_mip_levels() : base_mip_level + mip_level_count;
+	uint32_t end_array_layer = array_layer_count == VK_REMAINING_ARRAY_LAYERS ? image.get_array_layers() : base_array_layer + array_layer_count;
+
+	for (uint32_t array_layer = base_array_layer; array_layer < end_array_layer; array_layer++) {
+		for (uint32_t mip_level = base_mip_level; mip_level < end_mip_level; mip_level++) {
+			const ImageState& previous = image.get_state(mip_level, array_layer);
+
+			if (previous.layout == state.layout && previous.is_read_only() && state.is_read_only()) {
+				image.set_state({ state.layout, previous.stage | state.stage, previous.access | state.access }, mip_level, array_layer);
+				continue;
+			}
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : previous.layout;
+			barrier.newLayout = state.layout;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = image.get();
+			barrier.subresourceRange.aspectMask = image.get_aspect();
+			barrier.subresourceRange.baseMipLevel = mip_level;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = array_layer;
+			barrier.subresourceRange.layerCount = 1;
+			// Reads don't need making available, only waiting on
+			barrier.srcAccessMask = previous.is_read_only() ? 0 : previous.access;
+			barrier.dstAccessMask = state.access;
+			image_barriers.push_back(barrier);
+
+			// Nothing has touched it yet, so there's nothing to wait for
+			src_stages |= previous.stage != 0 ? previous.stage : PipelineStage::TopOfPipe;
+			dest_stages |= state.stage;
+
+			image.set_state(state, mip_level, array_layer);
+		}
+	}
+}
+
+void BarrierBatch::add_buffer(const Buffer& buffer, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access, VkDeviceSize offset, VkDeviceSize size) {
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dest_access;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer.get();
+	barrier.offset = offset;
+	barrier.size = size;
+	buffer_barriers.push_back(barrier);
+
+	src_stages |= src_stage;
+	dest_stages |= dest_stage;
+}
+
+void BarrierBatch::add_memory(VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access) {
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dest_access;
+	memory_barriers.push_back(barrier);
+
+	src_stages |= src_stage;
+	dest_stages |= dest_stage;
+}
+
+/**
+ * One half of moving an exclusive buffer between queue families. The same barrier is recorded on both queues - on the
+ * source queue with dest_stage BottomOfPipe and no dest_access, then on the destination queue, after a semaphore wait,
+ * with src_stage TopOfPipe and no src_access
+ */
+void BarrierBatch::add_buffer_ownership(const Buffer& buffer, uint32_t src_family, uint32_t dest_family, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access) {
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = src_access;
+	barrier.dstAccessMask = dest_access;
+	barrier.srcQueueFamilyIndex = src_family;
+	barrier.dstQueueFamilyIndex = dest_family;
+	barrier.buffer = buffer.get();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	buffer_barriers.push_back(barrier);
+
+	src_stages |= src_stage;
+	dest_stages |= dest_stage;
+}
+
+/**
+ * Releases every subresource of image from src_family, moving it to new_layout. The acquire on dest_family must
+ * give the same layouts. Until then the image has no access to wait on, as the semaphore between the queues covers it
+ */
+void BarrierBatch::add_image_release(Image& image, VkImageLayout new_layout, uint32_t src_family, uint32_t dest_family) {
+	for (uint32_t array_layer = 0; array_layer < image.get_array_layers(); array_layer++) {
+		for (uint32_t mip_level = 0; mip_level < image.get_mip_levels(); mip_level++) {
+			const ImageState& previous = image.get_state(mip_level, array_layer);
+
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = previous.layout;
+			barrier.newLayout = new_layout;
+			barrier.srcQueueFamilyIndex = src_family;
+			barrier.dstQueueFamilyIndex = dest_family;
+			barrier.image = image.get();
+			barrier.subresourceRange.aspectMask = image.get_aspect();
+			barrier.subresourceRange.baseMipLevel = mip_level;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = array_layer;
+			barrier.subresourceRange.layerCount = 1;
+			barrier.srcAccessMask = previous.is_read_only() ? 0 : previous.access;
+			barrier.dstAccessMask = 0;
+			image_barriers.push_back(barrier);
+
+			src_stages |= previous.stage != 0 ? previous.stage : PipelineStage::TopOfPipe;
+			dest_stages |= PipelineStage::BottomOfPipe;
+
+			image.set_state({ new_layout, 0, 0 }, mip_level, array_layer);
+		}
+	}
+}
+
+void BarrierBatch::add_image_acquire(Image& image, VkImageLayout old_layout, const ImageState& state, uint32_t src_family, uint32_t dest_family) {
+	for (uint32_t array_layer = 0; array_layer < image.get_array_layers(); array_layer++) {
+		for (uint32_t mip_level = 0; mip_level < image.get_mip_levels(); mip_level++) {
+			VkImageMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.oldLayout = old_layout;
+			barrier.newLayout = state.layout;
+			barrier.srcQueueFamilyIndex = src_family;
+			barrier.dstQueueFamilyIndex = dest_family;
+			barrier.image = image.get();
+			barrier.subresourceRange.aspectMask = image.get_aspect();
+			barrier.subresourceRange.baseMipLevel = mip_level;
+			barrier.subresourceRange.levelCount = 1;
+			barrier.subresourceRange.baseArrayLayer = array_layer;
+			barrier.subresourceRange.layerCount = 1;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = state.access;
+			image_barriers.push_back(barrier);
+
+			src_stages |= PipelineStage::TopOfPipe;
+			dest_stages |= state.stage;
+
+			image.set_state(state, mip_level, array_layer);
+		}
+	}
+}
+
+bool BarrierBatch::empty() const {
+	return memory_barriers.empty() && buffer_barriers.empty() && image_barriers.empty();
+}
+
+void BarrierBatch::flush(VkCommandBuffer command_buffer) {
+	if (empty()) return;
+
+	vkCmdPipelineBarrier(
+		command_buffer,
+		src_stages, dest_stages,
+		0,
+		static_cast<uint32_t>(memory_barriers.size()), memory_barriers.data(),
+		static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+		static_cast<uint32_t>(image_barriers.size()), image_barriers.data()
+	);
+
+	clear();
+}
+
+void BarrierBatch::clear() {
+	src_stages = 0;
+	dest_stages = 0;
+	memory_barriers.clear();
+	buffer_barriers.clear();
+	image_barriers.clear();
+}
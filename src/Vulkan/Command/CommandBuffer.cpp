@@ -5,14 +5,16 @@
 #include "CommandPool.h"
 #include "Logger.h"
 #include "Helper.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
 
-CommandBuffer::CommandBuffer(Device &device, CommandPool &command_pool) :
-    device(device), command_pool(command_pool)
+CommandBuffer::CommandBuffer(Device &device, CommandPool &command_pool, VkCommandBufferLevel level) :
+    device(device), command_pool(command_pool), level(level)
 {
     VkCommandBufferAllocateInfo allocation_info{};
     allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocation_info.commandPool = command_pool.get();
-    allocation_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocation_info.level = level;
     allocation_info.commandBufferCount = 1;
 
     if (vkAllocateCommandBuffers(device.get(), &allocation_info, &command_buffer) != VK_SUCCESS) {
@@ -29,7 +31,14 @@ VkCommandBuffer CommandBuffer::get() {
     return command_buffer;
 }
 
+uint32_t CommandBuffer::get_queue_family_index() const {
+    return command_pool.get_queue_family_index();
+}
+
 void CommandBuffer::start_recording(bool one_time) {
+    barriers.clear();
+    render_pass = nullptr;
+    secondary_contents = false;
     VkCommandBufferBeginInfo begin_info{};
     begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     begin_info.flags = one_time ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0;
@@ -40,14 +49,55 @@ void CommandBuffer::start_recording(bool one_time) {
     }
 }
 
-void CommandBuffer::cmd_begin_render_pass(RenderPass &render_pass, Framebuffer &framebuffer, AttachmentDescriptions &attachment_descriptions) {
+/**
+ * Starts recording a secondary command buffer which continues the render pass primary is recording.
+ * Dynamic state isn't inherited, so viewport and scissor have to be set again
+ */
+void CommandBuffer::start_recording(const CommandBuffer& primary) {
+    if (level != VK_COMMAND_BUFFER_LEVEL_SECONDARY) {
+        throw std::runtime_error("Only secondary command buffers continue another's render pass");
+    }
+    if (primary.render_pass == nullptr) {
+        throw std::runtime_error("Primary command buffer isn't recording a render pass");
+    }
+
+    barriers.clear();
+    secondary_contents = false;
+    render_pass = primary.render_pass;
+    subpass = primary.subpass;
+    framebuffer = primary.framebuffer;
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = render_pass->get();
+    inheritance_info.subpass = subpass;
+    inheritance_info.framebuffer = framebuffer.value()->get();
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("Unable to start recording secondary command buffer");
+    }
+}
+
+/**
+ * With SECONDARY_COMMAND_BUFFERS contents, the render pass is only recorded into by cmd_execute_commands.
+ * Binds and draws throw until cmd_end_render_pass
+ */
+void CommandBuffer::cmd_begin_render_pass(RenderPass &render_pass, Framebuffer &framebuffer, AttachmentDescriptions &attachment_descriptions, VkSubpassContents contents) {
+    AllocationSite site("CommandBuffer::cmd_begin_render_pass");
+    cmd_flush_barriers();
     VkRenderPassBeginInfo render_pass_begin_info{};
     render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     render_pass_begin_info.renderPass = render_pass.get();
     render_pass_begin_info.framebuffer = framebuffer.get();
     render_pass_begin_info.renderArea.offset = { 0, 0 };
     render_pass_begin_info.renderArea.extent = framebuffer.extent;
-    std::vector<VkClearValue> clearColors{};
+    ArenaVector<VkClearValue> clearColors{};
+    clearColors.reserve(attachment_descriptions.attachment_descriptions.size());
     for (auto& attachment_description : attachment_descriptions.attachment_descriptions) {
         VkFormat format = attachment_description.format;
         if (has_depth(format) || has_stencil(format)) {
@@ -58,28 +108,37 @@ void CommandBuffer::cmd_begin_render_pass(RenderPass &render_pass, Framebuffer &
     }
     render_pass_begin_info.clearValueCount = clearColors.size();
     render_pass_begin_info.pClearValues = clearColors.data();
-    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, contents);
 
     this->framebuffer.emplace(&framebuffer);
+    this->render_pass = &render_pass;
+    subpass = 0;
+    secondary_contents = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
 }
 
 void CommandBuffer::cmd_bind_pipeline(Pipeline& pipeline) {
-    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get());
+    check_inline("cmd_bind_pipeline");
+    vkCmdBindPipeline(command_buffer, pipeline.get_bind_point(), pipeline.get());
 }
 
-void CommandBuffer::cmd_bind_vertex_buffer(Buffer &buffer) {
-    VkDeviceSize offsets[] = { 0 };
+void CommandBuffer::cmd_bind_vertex_buffer(Buffer &buffer, VkDeviceSize offset) {
+    check_inline("cmd_bind_vertex_buffer");
+    VkDeviceSize offsets[] = { offset };
     vkCmdBindVertexBuffers(command_buffer, 0, 1, &buffer.get(), offsets);
 }
 
-void CommandBuffer::cmd_bind_index_buffer(Buffer& buffer, VkIndexType index_type) {
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindIndexBuffer(command_buffer, buffer.get(), 0, index_type);
+void CommandBuffer::cmd_bind_index_buffer(Buffer& buffer, VkIndexType index_type, VkDeviceSize offset) {
+    check_inline("cmd_bind_index_buffer");
+    vkCmdBindIndexBuffer(command_buffer, buffer.get(), offset, index_type);
 }
 
-void CommandBuffer::cmd_bind_descriptor_set(DescriptorPool& descriptor_pool, Pipeline &pipeline, uint32_t descriptor_index) {
+/**
+ * Dynamic offsets are given in binding order, one for each UNIFORM_BUFFER_DYNAMIC binding in the set
+ */
+void CommandBuffer::cmd_bind_descriptor_set(DescriptorPool& descriptor_pool, Pipeline &pipeline, uint32_t descriptor_index, std::initializer_list<uint32_t> dynamic_offsets) {
+    check_inline("cmd_bind_descriptor_set");
     VkDescriptorSet descriptor_set = descriptor_pool.get_descriptor_set(descriptor_index);
-    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.get_layout(), 0, 1, &descriptor_set, 0, nullptr);
+    vkCmdBindDescriptorSets(command_buffer, pipeline.get_bind_point(), pipeline.get_layout(), 0, 1, &descriptor_set, static_cast<uint32_t>(dynamic_offsets.size()), dynamic_offsets.begin());
 }
 
 /**
@@ -98,6 +157,7 @@ void CommandBuffer::cmd_set_viewport() {
 }
 
 void CommandBuffer::cmd_set_viewport(VkViewport viewport) {
+    check_inline("cmd_set_viewport");
     vkCmdSetViewport(command_buffer, 0, 1, &viewport);
 }
 
@@ -113,96 +173,146 @@ void CommandBuffer::cmd_set_scissor() {
 }
 
 void CommandBuffer::cmd_set_scissor(VkRect2D scissor) {
+    check_inline("cmd_set_scissor");
     vkCmdSetScissor(command_buffer, 0, 1, &scissor);
 }
 
 void CommandBuffer::cmd_draw(size_t indices) {
+    check_inline("cmd_draw");
     vkCmdDraw(command_buffer, static_cast<uint32_t>(indices), 1, 0, 0);
 }
 
 void CommandBuffer::cmd_draw_indexed(size_t indices) {
+    check_inline("cmd_draw_indexed");
     vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(indices), 1, 0, 0, 0);
 }
 
+/**
+ * Runs the bound compute pipeline over a grid of workgroups. Dispatches happen outside render passes,
+ * so any queued barriers are flushed first
+ */
+void CommandBuffer::cmd_dispatch(uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+    cmd_flush_barriers();
+    vkCmdDispatch(command_buffer, group_count_x, group_count_y, group_count_z);
+}
+
+/**
+ * Reads the workgroup counts from a VkDispatchIndirectCommand in buffer, so a previous pass on the GPU
+ * can decide how much work there is. The buffer needs the Indirect usage, and a barrier making the write
+ * visible to PipelineStage::DrawIndirect with PipelineAccess::IndirectCommandRead
+ */
+void CommandBuffer::cmd_dispatch_indirect(Buffer& buffer, VkDeviceSize offset) {
+    cmd_flush_barriers();
+    vkCmdDispatchIndirect(command_buffer, buffer.get(), offset);
+}
+
 void CommandBuffer::cmd_end_render_pass() {
     vkCmdEndRenderPass(command_buffer);
+    render_pass = nullptr;
+    secondary_contents = false;
+}
+
+void CommandBuffer::cmd_execute_commands(std::span<CommandBuffer* const> secondary_command_buffers) {
+    AllocationSite site("CommandBuffer::cmd_execute_commands");
+    cmd_flush_barriers();
+    ArenaVector<VkCommandBuffer> vk_command_buffers;
+    vk_command_buffers.reserve(secondary_command_buffers.size());
+    for (CommandBuffer* secondary_command_buffer : secondary_command_buffers) {
+        vk_command_buffers.push_back(secondary_command_buffer->get());
+    }
+    vkCmdExecuteCommands(command_buffer, static_cast<uint32_t>(vk_command_buffers.size()), vk_command_buffers.data());
 }
 
-void CommandBuffer::cmd_copy_buffer(Buffer& src_buffer, Buffer& dest_buffer, size_t data_size) {
+void CommandBuffer::cmd_copy_buffer(Buffer& src_buffer, Buffer& dest_buffer, size_t data_size, VkDeviceSize src_offset, VkDeviceSize dest_offset) {
+    cmd_flush_barriers();
     VkBufferCopy copy_region{};
-    copy_region.srcOffset = 0; // Optional
-    copy_region.dstOffset = 0; // Optional
+    copy_region.srcOffset = src_offset;
+    copy_region.dstOffset = dest_offset;
     copy_region.size = data_size;
     vkCmdCopyBuffer(command_buffer, src_buffer.get(), dest_buffer.get(), 1, &copy_region);
 }
 
-void CommandBuffer::cmd_image_pipeline_barrier(const Image &image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout) {
-    VkPipelineStageFlags source_stage;
-    VkPipelineStageFlags destination_stage;
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = old_layout;
-    barrier.newLayout = new_layout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image.get();
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = 0; // TODO
-    barrier.dstAccessMask = 0; // TODO
-
-    if (new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-        if (has_stencil(format)) {
-            barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-        }
-    }
-    else {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    }
+void CommandBuffer::cmd_transition_image(Image& image, VkImageLayout new_layout, bool discard) {
+    cmd_transition_image(image, ImageState::for_layout(new_layout), discard);
+}
 
-    if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+/**
+ * Queues the barriers moving every subresource of image to new_state. Set discard if the current contents aren't needed
+ */
+void CommandBuffer::cmd_transition_image(Image& image, const ImageState& new_state, bool discard) {
+    barriers.add_image(image, new_state, discard, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+}
 
-        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+void CommandBuffer::cmd_transition_subresource(Image& image, const ImageState& new_state, uint32_t mip_level, uint32_t array_layer, bool discard) {
+    barriers.add_image(image, new_state, discard, mip_level, 1, array_layer, 1);
+}
 
-        source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destination_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    }
-    else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+void CommandBuffer::cmd_buffer_barrier(const Buffer& buffer, VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access, VkDeviceSize offset, VkDeviceSize size) {
+    barriers.add_buffer(buffer, src_stage, dest_stage, src_access, dest_access, offset, size);
+}
 
-        source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else {
-        throw std::invalid_argument("Unsupported layout transition");
-    }
-    
-    vkCmdPipelineBarrier(
+/**
+ * Gives buffer to another queue family. Record cmd_acquire_buffer on a queue of dest_family, after waiting on this submit
+ */
+void CommandBuffer::cmd_release_buffer(const Buffer& buffer, uint32_t dest_family, VkPipelineStageFlags src_stage, VkAccessFlags src_access) {
+    barriers.add_buffer_ownership(buffer, get_queue_family_index(), dest_family, src_stage, PipelineStage::BottomOfPipe, src_access, 0);
+}
+
+void CommandBuffer::cmd_acquire_buffer(const Buffer& buffer, uint32_t src_family, VkPipelineStageFlags dest_stage, VkAccessFlags dest_access) {
+    barriers.add_buffer_ownership(buffer, src_family, get_queue_family_index(), PipelineStage::TopOfPipe, dest_stage, 0, dest_access);
+}
+
+/**
+ * Gives image to another queue family, moving it to new_layout. The acquire must give the image's layout from before
+ * the release as old_layout
+ */
+void CommandBuffer::cmd_release_image(Image& image, uint32_t dest_family, VkImageLayout new_layout) {
+    barriers.add_image_release(image, new_layout, get_queue_family_index(), dest_family);
+}
+
+void CommandBuffer::cmd_acquire_image(Image& image, uint32_t src_family, VkImageLayout old_layout, const ImageState& new_state) {
+    barriers.add_image_acquire(image, old_layout, new_state, src_family, get_queue_family_index());
+}
+
+/**
+ * Records every queued barrier as one vkCmdPipelineBarrier. Commands which read or write resources call this first,
+ * so it only needs calling directly before commands recorded outside this class
+ */
+void CommandBuffer::cmd_flush_barriers() {
+    barriers.flush(command_buffer);
+}
+
+/**
+ * Copies the first mip level of a colour image. Expects src in TRANSFER_SRC and dest in TRANSFER_DST layout
+ */
+void CommandBuffer::cmd_copy_image(const Image& src_image, const Image& dest_image, uint32_t width, uint32_t height) {
+    cmd_flush_barriers();
+    VkImageCopy region{};
+    region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.srcSubresource.mipLevel = 0;
+    region.srcSubresource.baseArrayLayer = 0;
+    region.srcSubresource.layerCount = 1;
+    region.dstSubresource = region.srcSubresource;
+    region.srcOffset = { 0, 0, 0 };
+    region.dstOffset = { 0, 0, 0 };
+    region.extent = { width, height, 1 };
+
+    vkCmdCopyImage(
         command_buffer,
-        source_stage, destination_stage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
+        src_image.get(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        dest_image.get(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        1, &region
     );
 }
 
-void CommandBuffer::cmd_copy_buffer_to_image(const Buffer &buffer, const Image &image, uint32_t width, uint32_t height) {
+void CommandBuffer::cmd_memory_barrier(VkPipelineStageFlags src_stage, VkPipelineStageFlags dest_stage, VkAccessFlags src_access, VkAccessFlags dest_access) {
+    barriers.add_memory(src_stage, dest_stage, src_access, dest_access);
+}
+
+void CommandBuffer::cmd_copy_buffer_to_image(const Buffer &buffer, const Image &image, uint32_t width, uint32_t height, VkDeviceSize buffer_offset) {
+    cmd_flush_barriers();
     VkBufferImageCopy region{};
-    region.bufferOffset = 0;
+    region.bufferOffset = buffer_offset;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
 
@@ -229,11 +339,22 @@ void CommandBuffer::cmd_copy_buffer_to_image(const Buffer &buffer, const Image &
 }
 
 void CommandBuffer::stop_recording() {
+    cmd_flush_barriers();
     if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
         throw std::runtime_error("Unable to record command buffer");
     }
 }
 
+/**
+ * Throws if command would be recorded inline into a render pass which takes secondary command buffers only.
+ * The draws belong in the secondaries, e.g. those a ParallelRecorder records
+ */
+void CommandBuffer::check_inline(const char* command) const {
+    if (secondary_contents) {
+        throw std::runtime_error(std::string(command) + " can't be recorded inline in a render pass begun for secondary command buffers");
+    }
+}
+
 void CommandBuffer::reset() {
     vkResetCommandBuffer(command_buffer, 0);
 }
\ No newline at end of file
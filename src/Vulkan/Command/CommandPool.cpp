@@ -2,17 +2,18 @@
 
 #include "Queue.h"
 #include "Logger.h"
+#include "HostAllocator.h"
 #include <stdexcept>
 
-CommandPool::CommandPool(Device &device) :
-	device(device)
+CommandPool::CommandPool(Device &device, QueueType queue_type, VkCommandPoolCreateFlags flags) :
+	device(device), queue_family_index(device.queues.at(queue_type)->queue_family.index)
 {
 	VkCommandPoolCreateInfo command_pool_info{};
 	command_pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	command_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	command_pool_info.queueFamilyIndex = device.queues.at(GRAPHICS)->queue_family.index;
+	command_pool_info.flags = flags;
+	command_pool_info.queueFamilyIndex = queue_family_index;
 
-	if (vkCreateCommandPool(device.get(), &command_pool_info, nullptr, &command_pool) != VK_SUCCESS) {
+	if (vkCreateCommandPool(device.get(), &command_pool_info, HostAllocator::callbacks(), &command_pool) != VK_SUCCESS) {
 		throw std::runtime_error("Unable to create command pool");
 	}
 }
@@ -20,15 +21,46 @@ CommandPool::CommandPool(Device &device) :
 CommandPool::~CommandPool() {
 	Logger::log("Freeing Command Pool", Logger::VERBOSE);
 	command_buffers.clear();
-	vkDestroyCommandPool(device.get(), command_pool, nullptr);
+	secondary_command_buffers.clear();
+	vkDestroyCommandPool(device.get(), command_pool, HostAllocator::callbacks());
 }
 
 VkCommandPool CommandPool::get() {
 	return command_pool;
 }
 
-CommandBuffer &CommandPool::create_command_buffer() {
-	auto command_buffer = std::make_unique<CommandBuffer>(device, *this);
-	command_buffers.push_back(std::move(command_buffer));
-	return *command_buffers.back();
+uint32_t CommandPool::get_queue_family_index() const {
+	return queue_family_index;
+}
+
+CommandBuffer &CommandPool::create_command_buffer(VkCommandBufferLevel level) {
+	auto& buffers = level == VK_COMMAND_BUFFER_LEVEL_SECONDARY ? secondary_command_buffers : command_buffers;
+	buffers.push_back(std::make_unique<CommandBuffer>(device, *this, level));
+	return *buffers.back();
+}
+
+/**
+ * Hands out the pool's buffers in order, allocating only when every buffer has been used since the last reset.
+ * They're ready to record, as resetting the pool resets them all
+ */
+CommandBuffer &CommandPool::next_command_buffer(VkCommandBufferLevel level) {
+	bool secondary = level == VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	auto& buffers = secondary ? secondary_command_buffers : command_buffers;
+	size_t& next = secondary ? next_free_secondary : next_free;
+	if (next == buffers.size()) {
+		create_command_buffer(level);
+	}
+	return *buffers[next++];
+}
+
+/**
+ * Resets every buffer in the pool at once, keeping their memory for the next recording.
+ * None of them can still be in use by the GPU
+ */
+void CommandPool::reset() {
+	if (vkResetCommandPool(device.get(), command_pool, 0) != VK_SUCCESS) {
+		throw std::runtime_error("Unable to reset command pool");
+	}
+	next_free = 0;
+	next_free_secondary = 0;
 }
\ No newline at end of file
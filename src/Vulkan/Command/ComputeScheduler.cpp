@@ -0,0 +1,141 @@
+#include "ComputeScheduler.h"
+
+#include <stdexcept>
+
+#include "Logger.h"
+#include "Type.h"
+#include "AllocationTracker.h"
+
+ComputeScheduler::ComputeScheduler(Device& device, uint32_t frames_in_flight) :
+	device(device), compute_queue(*device.queues.at(COMPUTE)), graphics_queue(*device.queues.at(GRAPHICS))
+{
+	frames.resize(frames_in_flight);
+	for (Frame& frame : frames) {
+		frame.command_pool = std::make_unique<CommandPool>(device, COMPUTE, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	}
+
+	if (!is_async()) {
+		Logger::log("No separate compute queue, so compute work runs on the graphics queue", Logger::VERBOSE);
+	}
+}
+
+ComputeScheduler::~ComputeScheduler() {
+	Logger::log("Freeing Compute Scheduler", Logger::VERBOSE);
+	// The command buffers go with their pools
+	for (Frame& frame : frames) {
+		compute_queue.wait(frame.timeline_value);
+	}
+}
+
+/**
+ * Starts recording the compute work for frame, waiting for the work submitted the last time the frame was used
+ */
+CommandBuffer& ComputeScheduler::begin(uint32_t frame) {
+	if (recording != nullptr) {
+		throw std::runtime_error("Compute work is already being recorded, submit it first");
+	}
+
+	recording = &frames.at(frame);
+	compute_queue.wait(recording->timeline_value);
+
+	recording->command_pool->reset();
+	recording->command_buffer = &recording->command_pool->next_command_buffer();
+	recording->command_buffer->start_recording(true);
+	return *recording->command_buffer;
+}
+
+/**
+ * Hands a buffer written by this frame's compute work to graphics, which reads it at dest_stage with dest_access
+ */
+void ComputeScheduler::release_buffer(const Buffer& buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dest_stage, VkAccessFlags dest_access) {
+	CommandBuffer& command_buffer = *recording->command_buffer;
+	if (!transfers_ownership()) {
+		// The semaphore orders a separate queue's work, but a shared queue needs the barrier
+		if (!is_async()) command_buffer.cmd_buffer_barrier(buffer, src_stage, dest_stage, src_access, dest_access);
+		return;
+	}
+
+	command_buffer.cmd_release_buffer(buffer, graphics_queue.queue_family.index, src_stage, src_access);
+	buffer_handoffs.push_back({ &buffer, dest_stage, dest_access });
+}
+
+/**
+ * Hands an image written by this frame's compute work to graphics, which uses it in state
+ */
+void ComputeScheduler::release_image(Image& image, const ImageState& state) {
+	CommandBuffer& command_buffer = *recording->command_buffer;
+	if (!transfers_ownership()) {
+		command_buffer.cmd_transition_image(image, state);
+		return;
+	}
+
+	VkImageLayout old_layout = image.get_state().layout;
+	command_buffer.cmd_release_image(image, graphics_queue.queue_family.index, state.layout);
+	image_handoffs.push_back({ &image, old_layout, state });
+}
+
+/**
+ * Submits the frame's compute work. The returned wait goes into the graphics submit which uses the results,
+ * blocking it at dest_stage until compute has finished.
+ *
+ * It waits on the graphics work which acquired the last results as well as timeline_waits, so nothing it writes
+ * is still being read
+ */
+TimelineWait ComputeScheduler::submit(VkPipelineStageFlags dest_stage, std::span<const TimelineWait> timeline_waits) {
+	AllocationSite site("ComputeScheduler::submit");
+	if (recording == nullptr) {
+		throw std::runtime_error("No compute work is being recorded, call begin first");
+	}
+
+	if (acquired_after.has_value()) {
+		uint64_t submitted_value = graphics_queue.get_submitted_value();
+		if (submitted_value <= acquired_after.value()) {
+			throw std::runtime_error("Submit the graphics work which acquired the last compute results before submitting more compute work");
+		}
+		graphics_value = submitted_value;
+		acquired_after.reset();
+	}
+
+	this->timeline_waits.assign(timeline_waits.begin(), timeline_waits.end());
+	if (graphics_value > 0) {
+		this->timeline_waits.push_back({ &graphics_queue, graphics_value, PipelineStage::AllCommands });
+	}
+
+	recording->command_buffer->stop_recording();
+	recording->timeline_value = compute_queue.submit(*recording->command_buffer, {}, {}, this->timeline_waits);
+
+	TimelineWait wait{ &compute_queue, recording->timeline_value, dest_stage };
+	recording = nullptr;
+	return wait;
+}
+
+/**
+ * Records the other half of every release since the last acquire. Record it before the graphics commands using them,
+ * and submit them before the next compute submit
+ */
+void ComputeScheduler::acquire(CommandBuffer& graphics_command_buffer) {
+	acquired_after = graphics_queue.get_submitted_value();
+
+	uint32_t compute_family = compute_queue.queue_family.index;
+	for (BufferHandoff& handoff : buffer_handoffs) {
+		graphics_command_buffer.cmd_acquire_buffer(*handoff.buffer, compute_family, handoff.dest_stage, handoff.dest_access);
+	}
+	for (ImageHandoff& handoff : image_handoffs) {
+		graphics_command_buffer.cmd_acquire_image(*handoff.image, compute_family, handoff.old_layout, handoff.state);
+	}
+
+	buffer_handoffs.clear();
+	image_handoffs.clear();
+}
+
+bool ComputeScheduler::is_async() const {
+	return &compute_queue != &graphics_queue;
+}
+
+bool ComputeScheduler::transfers_ownership() const {
+	return compute_queue.queue_family.index != graphics_queue.queue_family.index;
+}
+
+Queue& ComputeScheduler::get_queue() {
+	return compute_queue;
+}
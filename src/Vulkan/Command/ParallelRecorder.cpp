@@ -0,0 +1,127 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+
+#include "Logger.h"
+#include "AllocationTracker.h"
+
+ParallelRecorder::ParallelRecorder(Device& device, uint32_t frames_in_flight, uint32_t thread_count) :
+	device(device), thread_count(std::max(thread_count, 1u))
+{
+	pools.resize(frames_in_flight);
+	for (auto& frame_pools : pools) {
+		for (uint32_t thread = 0; thread < this->thread_count; thread++) {
+			frame_pools.push_back(std::make_unique<CommandPool>(device, GRAPHICS, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT));
+		}
+	}
+	secondary_command_buffers.reserve(this->thread_count);
+
+	for (uint32_t thread = 1; thread < this->thread_count; thread++) {
+		workers.emplace_back(&ParallelRecorder::work, this, thread);
+	}
+
+	Logger::log("Recording draws across " + std::to_string(this->thread_count) + " threads", Logger::VERBOSE);
+}
+
+ParallelRecorder::~ParallelRecorder() {
+	Logger::log("Freeing Parallel Recorder", Logger::VERBOSE);
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+/**
+ * Resets the frame's pools. The frame's last submit must have finished
+ */
+void ParallelRecorder::begin_frame(uint32_t frame) {
+	current_frame = frame;
+	for (auto& pool : pools.at(frame)) {
+		pool->reset();
+	}
+}
+
+/**
+ * Records draw_count draws into primary's render pass, spread over as many threads as there are
+ * min_draws_per_thread draws for. Returns once every thread has finished and the primary has executed them
+ */
+void ParallelRecorder::record(CommandBuffer& primary, uint32_t draw_count, const RecordRange& record_range, uint32_t min_draws_per_thread) {
+	AllocationSite site("ParallelRecorder::record");
+	if (draw_count == 0) return;
+
+	uint32_t draws_per_thread = std::max(min_draws_per_thread, 1u);
+	uint32_t chunks = (draw_count + draws_per_thread - 1) / draws_per_thread;
+	{
+		std::lock_guard lock(mutex);
+		this->primary = &primary;
+		this->record_range = &record_range;
+		this->draw_count = draw_count;
+		chunk_count = std::clamp(chunks, 1u, thread_count);
+		secondary_command_buffers.assign(chunk_count, nullptr);
+		error = nullptr;
+		remaining = chunk_count - 1;
+		generation++;
+	}
+	if (chunk_count > 1) work_ready.notify_all();
+
+	try {
+		record_chunk(0);
+	} catch (...) {
+		std::lock_guard lock(mutex);
+		error = std::current_exception();
+	}
+
+	{
+		std::unique_lock lock(mutex);
+		work_done.wait(lock, [this] { return remaining == 0; });
+	}
+	if (error) std::rethrow_exception(error);
+
+	primary.cmd_execute_commands(secondary_command_buffers);
+}
+
+uint32_t ParallelRecorder::get_thread_count() const {
+	return thread_count;
+}
+
+void ParallelRecorder::work(uint32_t thread) {
+	uint64_t seen_generation = 0;
+	while (true) {
+		std::unique_lock lock(mutex);
+		work_ready.wait(lock, [this, seen_generation] { return stopping || generation != seen_generation; });
+		if (stopping) return;
+		seen_generation = generation;
+		if (thread >= chunk_count) continue;
+		lock.unlock();
+
+		std::exception_ptr chunk_error;
+		try {
+			record_chunk(thread);
+		} catch (...) {
+			chunk_error = std::current_exception();
+		}
+
+		lock.lock();
+		if (chunk_error && !error) error = chunk_error;
+		if (--remaining == 0) work_done.notify_one();
+	}
+}
+
+/**
+ * Each thread records one chunk, so the chunk is the thread's index
+ */
+void ParallelRecorder::record_chunk(uint32_t thread) {
+	uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(draw_count) * thread / chunk_count);
+	uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(draw_count) * (thread + 1) / chunk_count);
+
+	CommandBuffer& command_buffer = pools[current_frame][thread]->next_command_buffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+	command_buffer.start_recording(*primary);
+	(*record_range)(command_buffer, first, end - first);
+	command_buffer.stop_recording();
+
+	secondary_command_buffers[thread] = &command_buffer;
+}
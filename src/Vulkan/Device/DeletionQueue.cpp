@@ -0,0 +1,69 @@
+#include "DeletionQueue.h"
+
+#include <algorithm>
+
+#include "Device.h"
+#include "Queue.h"
+#include "Logger.h"
+
+DeletionQueue::DeletionQueue(Device& device) {
+	for (auto& pair : device.family_queues) {
+		for (auto& queue : pair.second) {
+			queues.push_back(queue.get());
+		}
+	}
+	completed_values.resize(queues.size());
+}
+
+DeletionQueue::~DeletionQueue() {
+	if (!entries.empty()) {
+		Logger::log("Deletion queue destroyed with " + std::to_string(entries.size()) + " resources left - call flush first", Logger::WARN);
+	}
+}
+
+void DeletionQueue::push(std::function<void()> destroy) {
+	Entry entry{};
+	entry.submitted_values.reserve(queues.size());
+	for (Queue* queue : queues) {
+		entry.submitted_values.push_back(queue->get_submitted_value());
+	}
+	entry.destroy = std::move(destroy);
+	entries.push_back(std::move(entry));
+}
+
+/**
+ * Call once a frame. Destroys everything whose queues have finished the work submitted before it was pushed
+ */
+void DeletionQueue::release() {
+	if (entries.empty()) return;
+
+	// Read each timeline once, rather than once per entry
+	for (size_t i = 0; i < queues.size(); i++) {
+		completed_values[i] = queues[i]->get_completed_value();
+	}
+
+	while (!entries.empty() && is_complete(entries.front())) {
+		// Take it off first, as destroying one resource can push more
+		std::function<void()> destroy = std::move(entries.front().destroy);
+		entries.pop_front();
+		destroy();
+	}
+}
+
+/**
+ * Destroys everything. Only call once the device is idle
+ */
+void DeletionQueue::flush() {
+	while (!entries.empty()) {
+		std::function<void()> destroy = std::move(entries.front().destroy);
+		entries.pop_front();
+		destroy();
+	}
+}
+
+bool DeletionQueue::is_complete(const Entry& entry) const {
+	for (size_t i = 0; i < queues.size(); i++) {
+		if (entry.submitted_values[i] > completed_values[i]) return false;
+	}
+	return true;
+}
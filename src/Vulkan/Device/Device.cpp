@@ -1,32 +1,61 @@
 #include "Device.h"
 
 #include "Queue.h"
+#include "MemoryAllocator.h"
+#include "ResourcePools.h"
+#include "DeletionQueue.h"
+#include "SyncPool.h"
 #include "Settings.h"
 #include "Logger.h"
+#include "HostAllocator.h"
 
 Device::Device(const PhysicalDevice &physical_device,
 	const QueueFamily &queue_family,
 	const Settings &settings,
 	const std::set<std::string> &required_extensions,
 	const std::set<std::string> &required_layers) :
-	physical_device(physical_device)
+	physical_device(physical_device), enabled_extensions(required_extensions)
 {
 
-	// Creates a queue for every queue family needed for full functionality
-	std::map<QueueFamily, std::shared_ptr<Queue>> created_queues;
+	// Creates as many queues as there are priorities (up to what the family has) for every queue family needed
 	std::vector<VkDeviceQueueCreateInfo> created_queue_info;
+	const float default_priority = 1.0f;
 
-	for (auto pair : physical_device.selected_family) {
-		std::shared_ptr<Queue> queue;
-		if (created_queues.contains(pair.second)) {
-			queue = created_queues.at(pair.second);
-		} else {
-			queue = std::make_shared<Queue>(pair.second);
-			created_queues.insert(std::pair(pair.second, queue));
-			created_queue_info.push_back(queue->queue_create_info);
+	for (auto& pair : physical_device.selected_family) {
+		QueueFamily queue_family = pair.second;
+		if (family_queues.contains(queue_family.index)) continue;
+
+		uint32_t queue_count = std::clamp<uint32_t>(static_cast<uint32_t>(settings.queue_priorities.size()), 1, queue_family.queue_count);
+		const float* priorities = settings.queue_priorities.empty() ? &default_priority : settings.queue_priorities.data();
+
+		std::vector<std::shared_ptr<Queue>>& created = family_queues[queue_family.index];
+		for (uint32_t i = 0; i < queue_count; i++) {
+			created.push_back(std::make_shared<Queue>(queue_family, i, priorities[i]));
 		}
 
-		queues.insert(std::pair(pair.first, queue));
+		VkDeviceQueueCreateInfo queue_create_info{};
+		queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queue_create_info.queueFamilyIndex = queue_family.index;
+		queue_create_info.queueCount = queue_count;
+		queue_create_info.pQueuePriorities = priorities;
+		created_queue_info.push_back(queue_create_info);
+	}
+
+	// Graphics takes its family's first queue. Other types sharing a family take the lower priority queues after
+	// it where there are any, so streaming and compute don't queue up behind rendering's submits
+	std::map<uint32_t, uint32_t> assigned;
+	for (auto& pair : physical_device.selected_family) {
+		if (pair.first == PRESENT) continue;
+		std::vector<std::shared_ptr<Queue>>& family = family_queues.at(pair.second.index);
+		uint32_t used = assigned[pair.second.index]++;
+		uint32_t index = used == 0 || family.size() == 1 ? 0 : 1 + (used - 1) % (static_cast<uint32_t>(family.size()) - 1);
+		queues.insert(std::pair(pair.first, family.at(index)));
+	}
+	// Presents wait on rendering, so they go to the graphics queue where it can present
+	if (physical_device.selected_family.contains(PRESENT)) {
+		uint32_t present_family = physical_device.selected_family.at(PRESENT).index;
+		bool graphics_presents = queues.contains(GRAPHICS) && queues.at(GRAPHICS)->queue_family.index == present_family;
+		queues.insert(std::pair(PRESENT, graphics_presents ? queues.at(GRAPHICS) : family_queues.at(present_family).at(0)));
 	}
 
 	// Copy extension list into new structure
@@ -43,6 +72,12 @@ Device::Device(const PhysicalDevice &physical_device,
 
 	// TODO enabling all features may be expensive
 	create_info.pEnabledFeatures = &physical_device.device_features;
+
+	VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan_12_features.timelineSemaphore = VK_TRUE;
+	create_info.pNext = &vulkan_12_features;
+
 	create_info.enabledExtensionCount = static_cast<uint32_t>(c_extensions.size());
 	create_info.ppEnabledExtensionNames = c_extensions.data();
 
@@ -58,25 +93,96 @@ Device::Device(const PhysicalDevice &physical_device,
 		create_info.enabledLayerCount = 0;
 	}
 
-	if (vkCreateDevice(physical_device.get(), &create_info, nullptr, &device) != VK_SUCCESS) {
+	if (vkCreateDevice(physical_device.get(), &create_info, HostAllocator::callbacks(), &device) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create device for chosen queue family and physical device");
 	}
 
-	for (auto& pair : created_queues) {
-		auto queue = pair.second;
-		queue->setup_queue(*this);
+	for (auto& pair : family_queues) {
+		for (auto& queue : pair.second) {
+			queue->setup_queue(*this);
+		}
 	}
+
+	allocator = std::make_unique<MemoryAllocator>(*this);
+	deletion_queue = std::make_unique<DeletionQueue>(*this);
+	sync_pool = std::make_unique<SyncPool>(*this);
+	resources = std::make_unique<ResourcePools>();
 }
 
 Device::~Device() {
 	Logger::log("Freeing Device", Logger::VERBOSE);
-	vkDestroyDevice(device, nullptr);
+	// Resources free their memory through the allocator, so they have to go first
+	resources.reset();
+	// Nothing can be in use once idle, so everything parked can go
+	wait_idle();
+	// Recycled semaphores are returned through the deletion queue, so the pool goes after it
+	deletion_queue->flush();
+	sync_pool.reset();
+	for (auto& pair : family_queues) {
+		for (auto& queue : pair.second) {
+			queue->teardown_queue();
+		}
+	}
+	allocator.reset();
+	vkDestroyDevice(device, HostAllocator::callbacks());
 }
 
 VkDevice Device::get() const {
 	return device;
 }
 
+/**
+ * vkDeviceWaitIdle needs every queue externally synchronised, so submits from other threads wait until it's done
+ */
 void Device::wait_idle() {
+	std::vector<std::unique_lock<std::mutex>> locks;
+	for (auto& [family, queues] : family_queues) {
+		for (auto& queue : queues) {
+			locks.push_back(queue->lock_submits());
+		}
+	}
 	vkDeviceWaitIdle(device);
-}
\ No newline at end of file
+}
+
+bool Device::has_extension(const std::string& extension) const {
+	return enabled_extensions.contains(extension);
+}
+
+MemoryAllocator& Device::get_allocator() const {
+	return *allocator;
+}
+
+ResourcePools& Device::get_resources() const {
+	return *resources;
+}
+
+/**
+ * The index-th queue of the family used for queue_type, for threads which submit on their own queue.
+ * Index 0 is the family's highest priority queue
+ */
+Queue& Device::get_queue(QueueType queue_type, uint32_t index) const {
+	return *family_queues.at(physical_device.selected_family.at(queue_type).index).at(index);
+}
+
+uint32_t Device::get_queue_count(QueueType queue_type) const {
+	return static_cast<uint32_t>(family_queues.at(physical_device.selected_family.at(queue_type).index).size());
+}
+
+DeletionQueue& Device::get_deletion_queue() const {
+	return *deletion_queue;
+}
+
+SyncPool& Device::get_sync_pool() const {
+	return *sync_pool;
+}
+
+/**
+ * The upload manager to tell when a buffer or image is destroyed, or nullptr if there isn't one
+ */
+UploadManager* Device::get_upload_manager() const {
+	return upload_manager;
+}
+
+void Device::set_upload_manager(UploadManager* upload_manager) {
+	this->upload_manager = upload_manager;
+}
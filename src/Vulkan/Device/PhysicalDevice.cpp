@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <map>
 #include <ranges>
+#include <functional>
 
 #include "Logger.h"
 #include "SwapChainDetails.h"
@@ -56,6 +57,18 @@ PhysicalDevice::PhysicalDevice(VkPhysicalDevice device, Surface &surface) : devi
 	vkGetPhysicalDeviceProperties(device, &device_properties);
 	vkGetPhysicalDeviceFeatures(device, &device_features);
 
+	if (device_properties.apiVersion >= VK_API_VERSION_1_2) {
+		VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+		vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &vulkan_12_features;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+
+		supports_timeline_semaphores = vulkan_12_features.timelineSemaphore == VK_TRUE;
+	}
+
 	uint32_t queue_family_count = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
 
@@ -69,18 +82,62 @@ PhysicalDevice::PhysicalDevice(VkPhysicalDevice device, Surface &surface) : devi
 		queue_families.push_back(QueueFamily(vk_queue_family, index++, *this, surface));
 		QueueFamily& queue_family = queue_families.back();
 
-		// TODO Don't just use first queue family that support each capability
-		if (queue_family.supports_graphics && !selected_family.contains(GRAPHICS)) selected_family.insert(std::pair(GRAPHICS, queue_family));
-		if (queue_family.supports_compute && !selected_family.contains(COMPUTE)) selected_family.insert(std::pair(COMPUTE, queue_family));
-		if (queue_family.supports_transfer && !selected_family.contains(TRANSFER)) selected_family.insert(std::pair(TRANSFER, queue_family));
-		if (queue_family.supports_present && !selected_family.contains(PRESENT)) selected_family.insert(std::pair(PRESENT, queue_family));
+		Logger::log("Found queue family " + std::to_string(queue_family.index) + ":", Logger::VERBOSE);
+		Logger::log("\t - Graphics: " + bool_str(queue_family.supports_graphics), Logger::VERBOSE);
+		Logger::log("\t - Compute:  " + bool_str(queue_family.supports_compute), Logger::VERBOSE);
+		Logger::log("\t - Transfer: " + bool_str(queue_family.supports_transfer), Logger::VERBOSE);
+		Logger::log("\t - Present:  " + bool_str(queue_family.supports_present), Logger::VERBOSE);
+	}
+
+	select_queue_families();
+}
 
-		Logger::log("Found queue family:", Logger::VERBOSE);
-		Logger::log("\t - Graphics: " + bool_str(selected_family.contains(GRAPHICS)), Logger::VERBOSE);
-		Logger::log("\t - Compute:  " + bool_str(selected_family.contains(COMPUTE)), Logger::VERBOSE);
-		Logger::log("\t - Transfer: " + bool_str(selected_family.contains(TRANSFER)), Logger::VERBOSE);
-		Logger::log("\t - Present:  " + bool_str(selected_family.contains(PRESENT)), Logger::VERBOSE);
+/**
+ * Picks a family for each queue type. Graphics families can also compute and transfer, so taking the first
+ * family for each would put everything on the graphics queue. Instead compute prefers a family without graphics
+ * (async compute) and transfer prefers one with neither (the copy engine), so their work runs alongside rendering
+ */
+void PhysicalDevice::select_queue_families() {
+	auto select = [this](QueueType queue_type, std::function<bool(const QueueFamily&)> supports, std::function<bool(const QueueFamily&)> preferred) {
+		const QueueFamily* selected = nullptr;
+		for (auto& queue_family : queue_families) {
+			if (!supports(queue_family)) continue;
+			if (preferred(queue_family)) {
+				selected = &queue_family;
+				break;
+			}
+			if (selected == nullptr) selected = &queue_family;
+		}
+		if (selected != nullptr) selected_family.insert(std::pair(queue_type, *selected));
+	};
+
+	// Presenting from the graphics family saves an ownership transfer of each swapchain image
+	select(GRAPHICS,
+		[](const QueueFamily& family) { return family.supports_graphics; },
+		[](const QueueFamily& family) { return family.supports_present; });
+	select(COMPUTE,
+		[](const QueueFamily& family) { return family.supports_compute; },
+		[](const QueueFamily& family) { return !family.supports_graphics; });
+	select(TRANSFER,
+		[](const QueueFamily& family) { return family.supports_transfer; },
+		[](const QueueFamily& family) { return !family.supports_graphics && !family.supports_compute; });
+
+	if (selected_family.contains(GRAPHICS) && selected_family.at(GRAPHICS).supports_present) {
+		selected_family.insert(std::pair(PRESENT, selected_family.at(GRAPHICS)));
+	} else {
+		select(PRESENT,
+			[](const QueueFamily& family) { return family.supports_present; },
+			[](const QueueFamily&) { return false; });
 	}
+
+	auto family_name = [this](QueueType queue_type) {
+		return selected_family.contains(queue_type) ? std::to_string(selected_family.at(queue_type).index) : std::string("none");
+	};
+	Logger::log("Selected queue families:", Logger::VERBOSE);
+	Logger::log("\t - Graphics: " + family_name(GRAPHICS), Logger::VERBOSE);
+	Logger::log("\t - Compute:  " + family_name(COMPUTE), Logger::VERBOSE);
+	Logger::log("\t - Transfer: " + family_name(TRANSFER), Logger::VERBOSE);
+	Logger::log("\t - Present:  " + family_name(PRESENT), Logger::VERBOSE);
 }
 
 VkPhysicalDevice PhysicalDevice::get() const {
@@ -93,7 +150,14 @@ VkPhysicalDeviceMemoryProperties PhysicalDevice::get_memory_properties() const {
 	return memory_properties;
 }
 
-uint32_t PhysicalDevice::find_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties) const {
+/**
+ * The first memory type with properties, preferring one which also has preferred_properties
+ */
+uint32_t PhysicalDevice::find_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred_properties) const {
+	if (preferred_properties != 0 && has_memory_type(type_mask, properties | preferred_properties)) {
+		return find_memory_type(type_mask, properties | preferred_properties);
+	}
+
 	VkPhysicalDeviceMemoryProperties memory_properties = get_memory_properties();
 
 	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
@@ -105,6 +169,18 @@ uint32_t PhysicalDevice::find_memory_type(uint32_t type_mask, VkMemoryPropertyFl
 	throw std::runtime_error("No memory type matches mask");
 }
 
+bool PhysicalDevice::has_memory_type(uint32_t type_mask, VkMemoryPropertyFlags properties) const {
+	VkPhysicalDeviceMemoryProperties memory_properties = get_memory_properties();
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+		if (type_mask & (1 << i) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 int PhysicalDevice::find_suitability(std::set<std::string> required_extensions, Surface& surface) {
 	const int NOT_SUITABLE = INT_MIN;
 	int suitability = 0;
@@ -138,6 +214,9 @@ int PhysicalDevice::find_suitability(std::set<std::string> required_extensions,
 	if (compute_family_exists) suitability += 2 << 0;
 	if (transfer_family_exists) suitability += 1 << 0;
 
+	// Queues sync on timeline semaphores
+	if (!supports_timeline_semaphores) suitability = NOT_SUITABLE;
+
 	if(!has_required_extension_support(required_extensions)) suitability = NOT_SUITABLE;
 	else {
 		// Slight inefficiency as we need to query the details again when creating the swapchain
@@ -159,7 +238,14 @@ bool PhysicalDevice::has_required_extension_support(std::set<std::string> requir
 	return required_extensions.empty();
 }
 
-std::vector<VkExtensionProperties> PhysicalDevice::get_supported_extensions() {
+bool PhysicalDevice::supports_extension(const std::string& extension) const {
+	for (auto& supported_extension : get_supported_extensions()) {
+		if (extension == supported_extension.extensionName) return true;
+	}
+	return false;
+}
+
+std::vector<VkExtensionProperties> PhysicalDevice::get_supported_extensions() const {
 	uint32_t extension_count;
 	vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
 
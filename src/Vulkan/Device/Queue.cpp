@@ -1,73 +1,117 @@
 #include "Queue.h"
 
+#include <vector>
+
 #include "Device.h"
+#include "SubmitBatch.h"
 #include "Helper.h"
+#include "AllocationTracker.h"
 
-Queue::Queue(QueueFamily &queue_family) : queue_family(queue_family) {
-	queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-	queue_create_info.queueFamilyIndex = queue_family.index;
-	queue_create_info.queueCount = 1;
-	queue_create_info.pQueuePriorities = &priority;
-}
+Queue::Queue(QueueFamily &queue_family, uint32_t queue_index, float priority) :
+	queue_family(queue_family), queue_index(queue_index), priority(priority) {}
 
 void Queue::setup_queue(Device &device) {
 	VkQueue queue;
-	vkGetDeviceQueue(device.get(), queue_family.index, 0, &queue);
+	vkGetDeviceQueue(device.get(), queue_family.index, queue_index, &queue);
 	this->queue = queue;
+	timeline = std::make_unique<TimelineSemaphore>(device);
+}
+
+/**
+ * Called by the device before it's destroyed, as the timeline semaphore belongs to it
+ */
+void Queue::teardown_queue() {
+	timeline.reset();
+	queue.reset();
 }
 
 VkQueue& Queue::get() {
 	return queue.value();
 }
 
-void Queue::submit(CommandBuffer& command_buffer) {
-	std::vector<std::pair<Semaphore*, VkPipelineStageFlags>> wait_semaphores;
-	std::vector<Semaphore*> signal_semaphores;
-	submit(command_buffer, wait_semaphores, signal_semaphores);
+uint64_t Queue::submit(CommandBuffer& command_buffer) {
+	return submit(command_buffer, {}, {});
 }
 
-void Queue::submit(CommandBuffer &command_buffer, std::vector<std::pair<Semaphore *, VkPipelineStageFlags>> &wait_semaphores, std::vector<Semaphore *> &signal_semaphores, std::optional<Fence *> fence) {
-	assert_setup();
-	std::vector<VkSemaphore> vk_wait_semaphores;
-	std::vector<VkPipelineStageFlags> vk_pipeline_stages;
-	for (auto& pair : wait_semaphores) {
-		vk_wait_semaphores.push_back(pair.first->get());
-		vk_pipeline_stages.push_back(pair.second);
-	}
+uint64_t Queue::submit(CommandBuffer &command_buffer, std::span<const std::pair<Semaphore *, VkPipelineStageFlags>> wait_semaphores, std::span<Semaphore * const> signal_semaphores, std::span<const TimelineWait> timeline_waits, std::optional<Fence *> fence) {
+	// Submits can come from any thread, so each has its own batch, reused so submitting doesn't allocate
+	thread_local SubmitBatch batch;
+	batch.clear();
+	batch.add(command_buffer, wait_semaphores, signal_semaphores, timeline_waits);
+	return submit(batch, fence);
+}
 
-	std::vector<VkSemaphore> vk_signal_semaphores;
-	for (auto& semaphore : signal_semaphores) {
-		vk_signal_semaphores.push_back(semaphore->get());
+/**
+ * Sends every submit in batch with one vkQueueSubmit, then empties it. Returns the timeline value of the last
+ * submit, which is reached once all of them have finished
+ */
+uint64_t Queue::submit(SubmitBatch& batch, std::optional<Fence*> fence) {
+	AllocationSite site("Queue::submit");
+	assert_setup();
+	batch.timeline_infos.resize(batch.submits.size());
+	batch.submit_infos.resize(batch.submits.size());
+
+	// Values are only known once the queue is locked, as another thread may submit first
+	std::lock_guard lock(submit_mutex);
+	uint64_t signal_value = submitted_value;
+	if (batch.empty()) return signal_value;
+
+	for (size_t i = 0; i < batch.submits.size(); i++) {
+		SubmitBatch::Submit& submit = batch.submits[i];
+		uint32_t timeline_signal = submit.first_signal + submit.signal_count - 1;
+		batch.signal_semaphores[timeline_signal] = timeline->get();
+		batch.signal_values[timeline_signal] = ++signal_value;
+
+		VkTimelineSemaphoreSubmitInfo& timeline_info = batch.timeline_infos[i];
+		timeline_info = {};
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.waitSemaphoreValueCount = submit.wait_count;
+		timeline_info.pWaitSemaphoreValues = submit.wait_count > 0 ? batch.wait_values.data() + submit.first_wait : VK_NULL_HANDLE;
+		timeline_info.signalSemaphoreValueCount = submit.signal_count;
+		timeline_info.pSignalSemaphoreValues = batch.signal_values.data() + submit.first_signal;
+
+		VkSubmitInfo& submit_info = batch.submit_infos[i];
+		submit_info = {};
+		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submit_info.pNext = &timeline_info;
+		submit_info.waitSemaphoreCount = submit.wait_count;
+		submit_info.pWaitSemaphores = submit.wait_count > 0 ? batch.wait_semaphores.data() + submit.first_wait : VK_NULL_HANDLE;
+		submit_info.pWaitDstStageMask = submit.wait_count > 0 ? batch.wait_stages.data() + submit.first_wait : VK_NULL_HANDLE;
+
+		submit_info.signalSemaphoreCount = submit.signal_count;
+		submit_info.pSignalSemaphores = batch.signal_semaphores.data() + submit.first_signal;
+
+		submit_info.commandBufferCount = submit.command_buffer_count;
+		submit_info.pCommandBuffers = batch.command_buffers.data() + submit.first_command_buffer;
 	}
 
-	VkCommandBuffer vk_command_buffer = command_buffer.get();
-
-	VkSubmitInfo submit_info{};
-	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.waitSemaphoreCount = wait_semaphores.size();
-	submit_info.pWaitSemaphores = !wait_semaphores.empty() ? vk_wait_semaphores.data() : VK_NULL_HANDLE;
-	submit_info.pWaitDstStageMask = !wait_semaphores.empty() ? vk_pipeline_stages.data() : VK_NULL_HANDLE;
-
-	submit_info.signalSemaphoreCount = signal_semaphores.size();
-	submit_info.pSignalSemaphores = !signal_semaphores.empty() ? vk_signal_semaphores.data() : VK_NULL_HANDLE;
-
-	submit_info.commandBufferCount = 1;
-	submit_info.pCommandBuffers = &vk_command_buffer;
-
 	VkFence vk_fence = fence.has_value() ? fence.value()->get() : VK_NULL_HANDLE;
 	
-	if (vkQueueSubmit(queue.value(), 1, &submit_info, vk_fence) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to submit command buffer");
+	if (vkQueueSubmit(queue.value(), static_cast<uint32_t>(batch.submit_infos.size()), batch.submit_infos.data(), vk_fence) != VK_SUCCESS) {
+		batch.clear();
+		throw std::runtime_error("Failed to submit command buffers");
+	}
+
+	submitted_value = signal_value;
+	for (size_t i = 0; i < batch.submits.size(); i++) {
+		if (batch.submits[i].signalled_value != nullptr) {
+			*batch.submits[i].signalled_value = signal_value - (batch.submits.size() - 1 - i);
+		}
 	}
+	batch.clear();
+	return signal_value;
 }
 
-void Queue::present(SwapChain& swap_chain, uint32_t index, std::vector<Semaphore *> &wait_semaphores) {
+void Queue::present(SwapChain& swap_chain, uint32_t index, std::span<Semaphore * const> wait_semaphores) {
+	AllocationSite site("Queue::present");
 	assert_setup();
 	if (!queue_family.supports_present) {
 		throw std::runtime_error("Attempting to present to queue without present capibilities");
 	}
 
-	std::vector<VkSemaphore> vk_wait_semaphores;
+	thread_local std::vector<VkSemaphore> vk_wait_semaphores;
+	vk_wait_semaphores.clear();
+	vk_wait_semaphores.reserve(wait_semaphores.size());
 	for (auto& semaphore : wait_semaphores) {
 		vk_wait_semaphores.push_back(semaphore->get());
 	}
@@ -84,7 +128,9 @@ void Queue::present(SwapChain& swap_chain, uint32_t index, std::vector<Semaphore
 	present_info.pImageIndices = &index;
 	present_info.pResults = nullptr;
 
+	std::unique_lock lock(submit_mutex);
 	VkResult result = vkQueuePresentKHR(queue.value(), &present_info);
+	lock.unlock();
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
 		throw SwapChainOutdated();
@@ -96,9 +142,55 @@ void Queue::present(SwapChain& swap_chain, uint32_t index, std::vector<Semaphore
 
 void Queue::wait_idle() {
 	assert_setup();
+	std::lock_guard lock(submit_mutex);
 	vkQueueWaitIdle(queue.value());
 }
 
+/**
+ * Holds off submits and presents to the queue until the lock is released, e.g. while the whole device is waited on
+ */
+std::unique_lock<std::mutex> Queue::lock_submits() {
+	return std::unique_lock(submit_mutex);
+}
+
+/**
+ * Waits on the host until the submit which returned value has finished. Returns false on timeout
+ */
+bool Queue::wait(uint64_t value, uint64_t timeout) {
+	assert_setup();
+	return timeline->wait(value, timeout);
+}
+
+bool Queue::is_complete(uint64_t value) {
+	assert_setup();
+	return timeline->is_complete(value);
+}
+
+/**
+ * The value the last submit will signal. Another thread may have submitted since it was read
+ */
+uint64_t Queue::get_submitted_value() const {
+	return submitted_value;
+}
+
+uint64_t Queue::get_completed_value() {
+	assert_setup();
+	return timeline->get_value();
+}
+
+uint32_t Queue::get_index() const {
+	return queue_index;
+}
+
+float Queue::get_priority() const {
+	return priority;
+}
+
+TimelineSemaphore& Queue::get_timeline() {
+	assert_setup();
+	return *timeline;
+}
+
 void Queue::assert_setup() {
 	if (!queue.has_value()) {
 		throw std::runtime_error("'setup_queue' must be called before using the queue");
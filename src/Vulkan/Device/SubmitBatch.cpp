@@ -0,0 +1,74 @@
+#include "SubmitBatch.h"
+
+#include "CommandBuffer.h"
+#include "Semaphore.h"
+
+/**
+ * Starts a new submit holding command_buffer. Binary semaphores are only needed for the swapchain - anything else
+ * should wait on a queue's timeline. signalled_value, if given, is set to the submit's timeline value when submitted
+ */
+void SubmitBatch::add(CommandBuffer& command_buffer, std::span<const std::pair<Semaphore*, VkPipelineStageFlags>> wait_semaphores, std::span<Semaphore* const> signal_semaphores, std::span<const TimelineWait> timeline_waits, uint64_t* signalled_value) {
+	Submit submit{};
+	submit.first_wait = static_cast<uint32_t>(this->wait_semaphores.size());
+	submit.first_command_buffer = static_cast<uint32_t>(command_buffers.size());
+	submit.first_signal = static_cast<uint32_t>(this->signal_semaphores.size());
+	submit.signalled_value = signalled_value;
+
+	// Values line up with the semaphores, and are ignored for binary ones
+	for (auto& pair : wait_semaphores) {
+		this->wait_semaphores.push_back(pair.first->get());
+		wait_stages.push_back(pair.second);
+		wait_values.push_back(0);
+	}
+	for (auto& wait : timeline_waits) {
+		this->wait_semaphores.push_back(wait.queue->get_timeline().get());
+		wait_stages.push_back(wait.stage);
+		wait_values.push_back(wait.value);
+	}
+
+	command_buffers.push_back(command_buffer.get());
+
+	for (auto& semaphore : signal_semaphores) {
+		this->signal_semaphores.push_back(semaphore->get());
+		signal_values.push_back(0);
+	}
+	this->signal_semaphores.push_back(VK_NULL_HANDLE);
+	signal_values.push_back(0);
+
+	submit.wait_count = static_cast<uint32_t>(this->wait_semaphores.size()) - submit.first_wait;
+	submit.command_buffer_count = 1;
+	submit.signal_count = static_cast<uint32_t>(this->signal_semaphores.size()) - submit.first_signal;
+	submits.push_back(submit);
+}
+
+/**
+ * Adds command_buffer to the last submit, to run after its other command buffers under the same semaphores
+ */
+void SubmitBatch::add_to_last(CommandBuffer& command_buffer) {
+	if (submits.empty()) {
+		add(command_buffer);
+		return;
+	}
+
+	// The last submit's command buffers are at the end, so this keeps them together
+	command_buffers.push_back(command_buffer.get());
+	submits.back().command_buffer_count++;
+}
+
+void SubmitBatch::clear() {
+	submits.clear();
+	wait_semaphores.clear();
+	wait_stages.clear();
+	wait_values.clear();
+	command_buffers.clear();
+	signal_semaphores.clear();
+	signal_values.clear();
+}
+
+bool SubmitBatch::empty() const {
+	return submits.empty();
+}
+
+uint32_t SubmitBatch::size() const {
+	return static_cast<uint32_t>(submits.size());
+}
@@ -6,6 +6,7 @@
 #include <optional>
 
 #include "Logger.h"
+#include "HostAllocator.h"
 
 Instance::Instance(
     const std::string &app_name, const Version &app_version,
@@ -85,7 +86,7 @@ Instance::Instance(
     create_info.enabledExtensionCount = c_extensions.size();
     create_info.ppEnabledExtensionNames = c_extensions.data();
 
-    VkResult result = vkCreateInstance(&create_info, nullptr, &instance);
+    VkResult result = vkCreateInstance(&create_info, HostAllocator::callbacks(), &instance);
     if (result != VK_SUCCESS) throw std::runtime_error("Failed to create instance.");
 
     if (debug_messenger.has_value()) debug_messenger.value().create_messenger(instance);
@@ -94,7 +95,7 @@ Instance::Instance(
 Instance::~Instance() {
     Logger::log("Freeing Instance", Logger::VERBOSE);
     if (debug_messenger.has_value()) debug_messenger.reset();
-    vkDestroyInstance(instance, nullptr);
+    vkDestroyInstance(instance, HostAllocator::callbacks());
 }
 
 VkInstance Instance::get() const {
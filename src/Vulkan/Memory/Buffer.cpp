@@ -1,53 +1,127 @@
 #include "Buffer.h"
 
-Buffer::Buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation) : device(device), buffer_size(buffer_size){
+#include <algorithm>
+
+#include "CommandBuffer.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
+#include "UploadManager.h"
+
+Buffer::Buffer(Device& device, const VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage, VkMemoryPropertyFlags memory_properties, LocalMemoryAllocation local_memory_allocation, VkMemoryPropertyFlags preferred_properties) : device(device), buffer_size(buffer_size){
 	if ((memory_properties & MemoryProperties::HostVisible) == 0 && local_memory_allocation == LocalMemory::Persistent) {
 		throw std::runtime_error("Local memory allocation must be set to LocalMemory::Dynamic if memory is not visible to the host");
 	}
-	
+
+	movable = (memory_properties & MemoryProperties::DeviceLocal) && !(memory_properties & MemoryProperties::HostVisible);
+	if (movable) {
+		// Moving is a GPU copy to a new buffer, which needs both transfer usages
+		buffer_usage |= BufferUsage::TransferSource | BufferUsage::TransferDestination;
+	}
+
+	create_handle(buffer_usage);
+
+	DedicatedResource dedicated = device.get_allocator().query_dedicated(buffer);
+	allocation = device.get_allocator().allocate(memory_requirements, memory_properties, AllocationTiling::LINEAR, get_memory_category(buffer_usage), preferred_properties, dedicated);
+
+	vkBindBufferMemory(device.get(), buffer, allocation.memory, allocation.offset);
+	coherent = device.get_allocator().is_coherent(allocation);
+
+	if (local_memory_allocation == LocalMemory::Persistent) {
+		mapped_memory = device.get_allocator().map(allocation);
+	}
+
+	if (movable) {
+		device.get_allocator().set_owner(allocation, this);
+	}
+}
+
+/**
+ * Creates a buffer like source, bound to a new allocation. Used as the destination of a move
+ */
+Buffer::Buffer(const Buffer& source, const Allocation& allocation) : device(source.device), buffer_size(source.buffer_size), allocation(allocation), coherent(source.coherent) {
+	create_handle(source.buffer_usage);
+	vkBindBufferMemory(device.get(), buffer, allocation.memory, allocation.offset);
+}
+
+void Buffer::create_handle(VkBufferUsageFlags buffer_usage) {
+	this->buffer_usage = buffer_usage;
+
 	VkBufferCreateInfo buffer_info{};
 	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	buffer_info.size = buffer_size;
 	buffer_info.usage = buffer_usage;
 	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkCreateBuffer(device.get(), &buffer_info, nullptr, &buffer) != VK_SUCCESS) {
+	if (vkCreateBuffer(device.get(), &buffer_info, HostAllocator::callbacks(), &buffer) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create buffer");
 	}
 
 	vkGetBufferMemoryRequirements(device.get(), buffer, &memory_requirements);
+}
 
-	VkMemoryAllocateInfo memory_alloc_info{};
-	memory_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memory_alloc_info.allocationSize = memory_requirements.size;
-	memory_alloc_info.memoryTypeIndex = device.physical_device.find_memory_type(memory_requirements.memoryTypeBits, memory_properties);
+/**
+ * Memory requirements of a buffer before creating it, e.g. to choose its memory. Asks through a handle which is
+ * destroyed straight away, as vkGetDeviceBufferMemoryRequirements needs Vulkan 1.3
+ */
+VkMemoryRequirements Buffer::query_memory_requirements(Device& device, VkDeviceSize buffer_size, VkBufferUsageFlags buffer_usage) {
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.size = buffer_size;
+	buffer_info.usage = buffer_usage;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkAllocateMemory(device.get(), &memory_alloc_info, nullptr, &device_memory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate memory");
+	VkBuffer buffer;
+	if (vkCreateBuffer(device.get(), &buffer_info, HostAllocator::callbacks(), &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create buffer");
 	}
 
-	vkBindBufferMemory(device.get(), buffer, device_memory, 0);
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device.get(), buffer, &requirements);
+	// Never bound or used, so it can go now rather than through the deletion queue
+	vkDestroyBuffer(device.get(), buffer, HostAllocator::callbacks());
+	return requirements;
+}
 
-	if (local_memory_allocation == LocalMemory::Persistent) {
-		void* mapped_memory;
-		vkMapMemory(device.get(), device_memory, 0, buffer_size, 0, &mapped_memory);
-		this->mapped_memory = mapped_memory;
-	}
+/**
+ * Guesses what the buffer holds from its usage, for memory reports
+ */
+MemoryCategory Buffer::get_memory_category(VkBufferUsageFlags buffer_usage) {
+	if (buffer_usage & BufferUsage::Vertex) return MemoryCategory::VERTEX;
+	if (buffer_usage & BufferUsage::Index) return MemoryCategory::INDEX;
+	if (buffer_usage & BufferUsage::Uniform) return MemoryCategory::UNIFORM;
+	if (buffer_usage == BufferUsage::TransferSource) return MemoryCategory::STAGING;
+	return MemoryCategory::OTHER;
 }
 
 Buffer::~Buffer() {
 	Logger::log("Freeing Buffer", Logger::VERBOSE);
+	if (movable) {
+		device.get_allocator().release_owner(allocation, this);
+	}
+	// Only a transfer destination can have uploads in flight
+	UploadManager* upload_manager = device.get_upload_manager();
+	if (upload_manager != nullptr && (buffer_usage & BufferUsage::TransferDestination)) {
+		upload_manager->cancel(*this);
+	}
 	if (mapped_memory.has_value()) {
-		vkUnmapMemory(device.get(), device_memory);
+		device.get_allocator().unmap(allocation);
 	}
-	vkDestroyBuffer(device.get(), buffer, nullptr);
-	vkFreeMemory(device.get(), device_memory, nullptr);
+
+	// Frames in flight may still be reading it
+	device.get_deletion_queue().push([vk_device = device.get(), buffer = buffer, allocation = allocation, allocator = &device.get_allocator()]() mutable {
+		vkDestroyBuffer(vk_device, buffer, HostAllocator::callbacks());
+		allocator->free(allocation);
+	});
 }
 
 const VkBuffer& Buffer::get() const {
 	return buffer;
 }
 
+VkDeviceSize Buffer::get_size() const {
+	return buffer_size;
+}
+
 void Buffer::fill_buffer(const void* data, VkDeviceSize data_size, uint32_t offset) {
 	// We'll assume they want to fill in the data iff the host can access the memory
 	if (offset + data_size > buffer_size) {
@@ -57,12 +131,119 @@ void Buffer::fill_buffer(const void* data, VkDeviceSize data_size, uint32_t offs
 	bool is_persistent = this->mapped_memory.has_value();
 	void* mapped_memory;
 	if (!is_persistent) {
-		vkMapMemory(device.get(), device_memory, offset, data_size, 0, &mapped_memory);
+		mapped_memory = device.get_allocator().map(allocation);
+	} else {
+		mapped_memory = this->mapped_memory.value();
+	}
+	memcpy(static_cast<char*>(mapped_memory) + offset, data, data_size);
+	if (!coherent) {
+		dirty_ranges.emplace_back(offset, data_size);
+	}
+	if (!is_persistent) {
+		// Writes must be flushed while the memory is still mapped
+		flush();
+		device.get_allocator().unmap(allocation);
+	}
+}
+
+/**
+ * Reads are slow from uncached memory, so buffers the host reads back should be created preferring MemoryProperties::HostCached
+ */
+void Buffer::read_buffer(void* data, VkDeviceSize data_size, uint32_t offset) {
+	if (offset + data_size > buffer_size) {
+		throw std::runtime_error("Attempted to read beyond the end of the buffer");
+	}
+
+	bool is_persistent = this->mapped_memory.has_value();
+	void* mapped_memory;
+	if (!is_persistent) {
+		mapped_memory = device.get_allocator().map(allocation);
 	} else {
 		mapped_memory = this->mapped_memory.value();
 	}
-	memcpy(mapped_memory, data, data_size);
+	invalidate(data_size, offset);
+	memcpy(data, static_cast<char*>(mapped_memory) + offset, data_size);
 	if (!is_persistent) {
-		vkUnmapMemory(device.get(), device_memory);
+		device.get_allocator().unmap(allocation);
+	}
+}
+
+/**
+ * Makes host writes to non-coherent memory visible to the device. Dirty ranges are merged and
+ * flushed in a single call, so persistently mapped buffers should flush once after all their writes
+ */
+void Buffer::flush() {
+	if (coherent || dirty_ranges.empty()) return;
+
+	std::sort(dirty_ranges.begin(), dirty_ranges.end());
+
+	std::vector<VkMappedMemoryRange> ranges;
+	VkDeviceSize start = dirty_ranges[0].first;
+	VkDeviceSize end = start + dirty_ranges[0].second;
+	for (size_t i = 1; i < dirty_ranges.size(); i++) {
+		auto [range_start, range_size] = dirty_ranges[i];
+		if (range_start > end) {
+			ranges.push_back(device.get_allocator().get_mapped_range(allocation, start, end - start));
+			start = range_start;
+		}
+		end = std::max(end, range_start + range_size);
+	}
+	ranges.push_back(device.get_allocator().get_mapped_range(allocation, start, end - start));
+	dirty_ranges.clear();
+
+	if (vkFlushMappedMemoryRanges(device.get(), static_cast<uint32_t>(ranges.size()), ranges.data()) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to flush buffer memory");
 	}
+}
+
+/**
+ * Makes device writes to non-coherent memory visible to the host before reading them back
+ */
+void Buffer::invalidate(VkDeviceSize data_size, uint32_t offset) {
+	if (coherent) return;
+
+	VkDeviceSize size = data_size == VK_WHOLE_SIZE ? buffer_size - offset : data_size;
+	VkMappedMemoryRange range = device.get_allocator().get_mapped_range(allocation, offset, size);
+	if (vkInvalidateMappedMemoryRanges(device.get(), 1, &range) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to invalidate buffer memory");
+	}
+}
+
+bool Buffer::is_coherent() const {
+	return coherent;
+}
+
+/**
+ * The persistent mapping, holding the host's own writes whether or not they've been flushed yet
+ */
+const void* Buffer::get_mapped_memory() const {
+	if (!mapped_memory.has_value()) {
+		throw std::runtime_error("Buffer isn't persistently mapped");
+	}
+	return mapped_memory.value();
+}
+
+const Allocation& Buffer::get_allocation() const {
+	return allocation;
+}
+
+void Buffer::record_move(CommandBuffer& command_buffer, const Allocation& new_allocation) {
+	moved_buffer = std::unique_ptr<Buffer>(new Buffer(*this, new_allocation));
+	command_buffer.cmd_copy_buffer(*this, *moved_buffer, buffer_size);
+}
+
+/**
+ * Swaps in the moved buffer's handle and memory. The returned buffer holds the old ones
+ */
+std::unique_ptr<Defragmentable> Buffer::finish_move() {
+	MemoryAllocator& allocator = device.get_allocator();
+	allocator.set_owner(allocation, nullptr);
+	std::swap(buffer, moved_buffer->buffer);
+	std::swap(allocation, moved_buffer->allocation);
+	allocator.set_owner(allocation, this);
+	return std::move(moved_buffer);
+}
+
+void Buffer::cancel_move() {
+	moved_buffer.reset();
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "Defragmenter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "Queue.h"
+#include "SubmitBatch.h"
+#include "Logger.h"
+#include "Type.h"
+#include "AllocationTracker.h"
+
+Defragmenter::Defragmenter(Device& device, CommandPool& command_pool, Queue& queue, SubmitBatch& submits, UploadManager& upload_manager, VkDeviceSize bytes_per_frame) :
+	bytes_per_frame(bytes_per_frame), device(device), queue(queue), submits(submits), upload_manager(upload_manager),
+	command_buffer(command_pool.create_command_buffer())
+{
+	device.get_allocator().set_defragmenter(this);
+}
+
+Defragmenter::~Defragmenter() {
+	Logger::log("Freeing Defragmenter", Logger::VERBOSE);
+	if (batch_in_flight) {
+		submit_queued();
+		queue.wait(batch_value);
+		cancel_batch();
+	}
+	device.get_allocator().set_defragmenter(nullptr);
+}
+
+/**
+ * Call once a frame. Finishes the batch in flight if its copies are done, otherwise starts a new one
+ */
+void Defragmenter::update() {
+	AllocationSite site("Defragmenter::update");
+	if (batch_in_flight) {
+		if (batch_value == queued || !queue.is_complete(batch_value)) return;
+
+		finish_batch();
+		return;
+	}
+
+	// Only move resources whose contents (and image layouts) are settled
+	if (upload_manager.is_idle()) {
+		start_batch();
+	}
+}
+
+/**
+ * Called when a resource is destroyed. If it's part of the batch in flight, its copy is thrown away
+ */
+void Defragmenter::cancel(Defragmentable* resource) {
+	std::vector<Defragmentable*>* list = &moves;
+	auto it = std::find(moves.begin(), moves.end(), resource);
+	if (it == moves.end()) {
+		list = &stale_moves;
+		it = std::find(stale_moves.begin(), stale_moves.end(), resource);
+		if (it == stale_moves.end()) return;
+	}
+
+	submit_queued();
+	queue.wait(batch_value);
+	resource->cancel_move();
+	list->erase(it);
+}
+
+/**
+ * Called before a resource is written. Anything written after its copy was recorded would go to the old resource,
+ * so its move is cancelled once the batch finishes, without waiting here
+ */
+void Defragmenter::invalidate(Defragmentable* resource) {
+	auto it = std::find(moves.begin(), moves.end(), resource);
+	if (it == moves.end()) return;
+
+	stale_moves.push_back(resource);
+	moves.erase(it);
+}
+
+void Defragmenter::start_batch() {
+	MemoryAllocator& allocator = device.get_allocator();
+
+	std::vector<std::pair<Defragmentable*, Allocation>> planned_moves;
+	VkDeviceSize planned_bytes = 0;
+	for (uint32_t memory_type = 0; memory_type < VK_MAX_MEMORY_TYPES && planned_bytes < bytes_per_frame; memory_type++) {
+		MemoryBlock* block = allocator.find_sparsest_block(memory_type);
+		if (block == nullptr) continue;
+
+		for (Defragmentable* resource : block->get_owners()) {
+			if (planned_bytes >= bytes_per_frame) break;
+
+			std::optional<Allocation> new_allocation = allocator.reallocate(resource->get_allocation(), block);
+			if (!new_allocation.has_value()) break;
+
+			planned_moves.emplace_back(resource, new_allocation.value());
+			planned_bytes += new_allocation->size;
+		}
+	}
+
+	if (planned_moves.empty()) return;
+
+	command_buffer.reset();
+	command_buffer.start_recording(true);
+	for (auto& [resource, new_allocation] : planned_moves) {
+		resource->record_move(command_buffer, new_allocation);
+		moves.push_back(resource);
+	}
+	// Later frames on this queue read the moved resources
+	command_buffer.cmd_memory_barrier(PipelineStage::TransferBit, PipelineStage::AllCommands, PipelineAccess::TransferWrite, PipelineAccess::MemoryRead);
+	command_buffer.stop_recording();
+
+	// Goes out with the frame's submit, which sets the value
+	batch_in_flight = true;
+	batch_value = queued;
+	submits.add(command_buffer, {}, {}, {}, &batch_value);
+
+	Logger::log("Defragmenting " + std::to_string(planned_bytes) + " bytes across " + std::to_string(planned_moves.size()) + " resources", Logger::VERBOSE);
+}
+
+/**
+ * Submits the batch now if it's still waiting in the frame's submit batch, so it can be waited on
+ */
+void Defragmenter::submit_queued() {
+	if (batch_in_flight && batch_value == queued) {
+		queue.submit(submits);
+	}
+}
+
+void Defragmenter::finish_batch() {
+	for (Defragmentable* resource : moves) {
+		// Destroying the old handles parks them on the deletion queue, as earlier frames may still use them
+		resource->finish_move();
+	}
+	if (!moves.empty()) {
+		device.get_allocator().notify_moved();
+	}
+	moves.clear();
+
+	// Whatever was written mid-copy stays where it is
+	cancel_batch();
+}
+
+void Defragmenter::cancel_batch() {
+	// A queued batch is still in the frame's submit batch, which would run it and write batch_value later
+	assert(batch_value != queued);
+	for (Defragmentable* resource : moves) {
+		resource->cancel_move();
+	}
+	for (Defragmentable* resource : stale_moves) {
+		resource->cancel_move();
+	}
+	moves.clear();
+	stale_moves.clear();
+	batch_in_flight = false;
+}
@@ -0,0 +1,96 @@
+#include "DynamicBuffer.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+
+#include "Type.h"
+#include "Logger.h"
+
+DynamicBuffer::DynamicBuffer(Device& device, VkBufferUsageFlags buffer_usage, VkDeviceSize initial_size, uint32_t frames) :
+	buffer_usage(buffer_usage), device(device), capacity(std::max<VkDeviceSize>(initial_size, default_alignment))
+{
+	for (uint32_t i = 0; i < frames; i++) {
+		buffers.push_back(create_frame_buffer(capacity));
+	}
+}
+
+/**
+ * Resets the buffer for the given frame, growing it if another frame has grown since. Only call once
+ * that frame's previous submission has finished
+ */
+void DynamicBuffer::begin_frame(uint32_t frame) {
+	if (frame >= buffers.size()) {
+		throw std::runtime_error("Dynamic buffer frame out of range");
+	}
+
+	current_frame = frame;
+	head = 0;
+
+	if (buffers[frame]->get_size() < capacity) {
+		buffers[frame] = create_frame_buffer(capacity);
+	}
+}
+
+/**
+ * Reserves size bytes in the current frame's buffer and returns their offset. The buffer may be replaced
+ * when it grows, so bind get_buffer() once all of the frame's writes are done
+ */
+VkDeviceSize DynamicBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+	if (offset + size > buffers[current_frame]->get_size()) {
+		grow(offset + size);
+	}
+
+	head = offset + size;
+	return offset;
+}
+
+VkDeviceSize DynamicBuffer::push(const void* data, VkDeviceSize size, VkDeviceSize alignment) {
+	VkDeviceSize offset = allocate(size, alignment);
+	buffers[current_frame]->fill_buffer(data, size, static_cast<uint32_t>(offset));
+	return offset;
+}
+
+/**
+ * Flushes everything pushed this frame. Call once after the frame's pushes, before submitting
+ */
+void DynamicBuffer::flush() {
+	buffers[current_frame]->flush();
+}
+
+Buffer& DynamicBuffer::get_buffer() {
+	return *buffers[current_frame];
+}
+
+VkDeviceSize DynamicBuffer::get_capacity() const {
+	return capacity;
+}
+
+VkDeviceSize DynamicBuffer::get_used() const {
+	return head;
+}
+
+std::unique_ptr<Buffer> DynamicBuffer::create_frame_buffer(VkDeviceSize size) {
+	return Buffer::create_empty_buffer(device, size, buffer_usage, MemoryProperties::HostVisible, LocalMemory::Persistent, MemoryProperties::HostCached);
+}
+
+/**
+ * Replaces the current frame's buffer with a larger one, carrying over what's been written this frame
+ * so offsets already handed out stay valid. Nothing has been submitted with this frame's buffer yet,
+ * so the old one can go straight away
+ */
+void DynamicBuffer::grow(VkDeviceSize required_size) {
+	while (capacity < required_size) {
+		capacity *= growth_factor;
+	}
+	Logger::log("Growing dynamic buffer to " + std::to_string(capacity) + " bytes", Logger::VERBOSE);
+
+	std::unique_ptr<Buffer> grown_buffer = create_frame_buffer(capacity);
+	if (head > 0) {
+		// Copied straight from the mapping, as this frame's writes haven't been flushed - invalidating
+		// non-coherent memory now would throw them away
+		grown_buffer->fill_buffer(buffers[current_frame]->get_mapped_memory(), head);
+	}
+	buffers[current_frame] = std::move(grown_buffer);
+}
@@ -0,0 +1,71 @@
+#include "FrameArena.h"
+
+#include <new>
+#include <string>
+
+#include "Logger.h"
+#include "AllocationTracker.h"
+
+FrameArena& FrameArena::get() {
+	static FrameArena frame_arena;
+	return frame_arena;
+}
+
+FrameArena::FrameArena() {
+	// Something may allocate before the first frame begins, so there's always a region to use
+	regions.push_back({ static_cast<char*>(::operator new(default_region_size)), 0 });
+}
+
+FrameArena::~FrameArena() {
+	for (Region& region : regions) {
+		::operator delete(region.memory);
+	}
+}
+
+/**
+ * Switches to the frame's region and resets it. Only call once the frame's previous submission has finished
+ */
+void FrameArena::begin_frame(uint32_t frame) {
+	while (frame >= regions.size()) {
+		regions.push_back({ static_cast<char*>(::operator new(default_region_size)), 0 });
+	}
+
+	current_region = frame;
+	regions[frame].head = 0;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+	AllocationSite site("FrameArena::allocate");
+	Region& region = regions[current_region];
+	size_t offset = (region.head + alignment - 1) / alignment * alignment;
+	if (offset + size > default_region_size) {
+		if (overflow_count++ == 0) {
+			Logger::log("Frame arena region of " + std::to_string(default_region_size) + " bytes is full, falling back to the heap", Logger::WARN);
+		}
+		// Containers only need fundamental alignment, which plain new already gives
+		return ::operator new(size);
+	}
+
+	region.head = offset + size;
+	return region.memory + offset;
+}
+
+/**
+ * Arena memory is reclaimed when its region is reset, so only heap fallbacks are freed here
+ */
+void FrameArena::deallocate(void* memory) {
+	if (memory == nullptr || owns(memory)) return;
+	::operator delete(memory);
+}
+
+uint64_t FrameArena::get_overflow_count() const {
+	return overflow_count;
+}
+
+bool FrameArena::owns(const void* memory) const {
+	const char* pointer = static_cast<const char*>(memory);
+	for (const Region& region : regions) {
+		if (pointer >= region.memory && pointer < region.memory + default_region_size) return true;
+	}
+	return false;
+}
@@ -0,0 +1,250 @@
+#include "HostAllocator.h"
+
+#include <new>
+#include <cstring>
+#include <algorithm>
+#include <sstream>
+
+#include "Logger.h"
+
+namespace {
+	size_t align_up(size_t value, size_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	const char* scope_name(size_t scope) {
+		switch (scope) {
+		case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "command";
+		case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "object";
+		case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "cache";
+		case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "device";
+		case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "instance";
+		default: return "unknown";
+		}
+	}
+}
+
+HostAllocator& HostAllocator::get() {
+	// Outlives every Vulkan object, as it's destroyed after main returns
+	static HostAllocator host_allocator;
+	return host_allocator;
+}
+
+const VkAllocationCallbacks* HostAllocator::callbacks() {
+	return &get().allocation_callbacks;
+}
+
+HostAllocator::HostAllocator() {
+	allocation_callbacks.pUserData = this;
+	allocation_callbacks.pfnAllocation = vk_allocate;
+	allocation_callbacks.pfnReallocation = vk_reallocate;
+	allocation_callbacks.pfnFree = vk_free;
+	allocation_callbacks.pfnInternalAllocation = vk_internal_allocation;
+	allocation_callbacks.pfnInternalFree = vk_internal_free;
+
+	arena = static_cast<char*>(::operator new(arena_size, std::align_val_t(max_pooled_alignment)));
+}
+
+HostAllocator::~HostAllocator() {
+	for (char* slab : slabs) {
+		::operator delete(slab, std::align_val_t(max_pooled_alignment));
+	}
+	::operator delete(arena, std::align_val_t(max_pooled_alignment));
+}
+
+/**
+ * Resets the command scope arena. Call once a frame from the thread making Vulkan calls
+ */
+void HostAllocator::begin_frame() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (arena_live > 0) {
+		Logger::log("Command scope host allocations still live at the start of a frame, not resetting arena", Logger::WARN);
+		return;
+	}
+	arena_head = 0;
+}
+
+HostAllocatorStatistics HostAllocator::get_statistics() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return statistics;
+}
+
+void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (size == 0) return nullptr;
+	alignment = std::max(alignment, alignof(Header));
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Source source = Source::HEAP;
+	uint8_t size_class = 0;
+	uint32_t offset = 0;
+	char* raw = nullptr;
+
+	if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && alignment <= max_pooled_alignment) {
+		raw = allocate_from_arena(size, alignment, offset);
+		if (raw != nullptr) {
+			source = Source::ARENA;
+			arena_live++;
+		} else {
+			statistics.arena_overflows++;
+		}
+	} else if (scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT && alignment <= max_pooled_alignment) {
+		offset = static_cast<uint32_t>(align_up(sizeof(Header), alignment));
+		if (offset + size <= max_size_class) {
+			raw = allocate_from_pool(offset + size, size_class);
+			source = Source::POOL;
+		}
+	}
+
+	if (raw == nullptr) {
+		raw = allocate_from_heap(size, alignment, offset);
+		source = Source::HEAP;
+		if (raw == nullptr) return nullptr;
+	}
+
+	char* memory = raw + offset;
+	Header* header = reinterpret_cast<Header*>(memory - sizeof(Header));
+	header->size = size;
+	header->offset = offset;
+	header->alignment = static_cast<uint32_t>(alignment);
+	header->source = source;
+	header->scope = static_cast<uint8_t>(scope);
+	header->size_class = size_class;
+
+	ScopeStatistics& scope_statistics = statistics.scopes[scope];
+	scope_statistics.allocations++;
+	scope_statistics.current_bytes += size;
+	scope_statistics.peak_bytes = std::max(scope_statistics.peak_bytes, scope_statistics.current_bytes);
+
+	return memory;
+}
+
+void* HostAllocator::reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	if (original == nullptr) return allocate(size, alignment, scope);
+	if (size == 0) {
+		free(original);
+		return nullptr;
+	}
+
+	size_t original_size = reinterpret_cast<Header*>(static_cast<char*>(original) - sizeof(Header))->size;
+	void* memory = allocate(size, alignment, scope);
+	if (memory == nullptr) return nullptr;
+
+	memcpy(memory, original, std::min(original_size, size));
+	free(original);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	statistics.scopes[scope].reallocations++;
+	return memory;
+}
+
+void HostAllocator::free(void* memory) {
+	if (memory == nullptr) return;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Header header = *reinterpret_cast<Header*>(static_cast<char*>(memory) - sizeof(Header));
+	char* raw = static_cast<char*>(memory) - header.offset;
+
+	switch (header.source) {
+	case Source::ARENA:
+		// The arena is reset as a whole, so just track that nothing is left in it
+		arena_live--;
+		break;
+	case Source::POOL:
+		free_slots[header.size_class].push_back(raw);
+		break;
+	case Source::HEAP:
+		::operator delete(raw, std::align_val_t(header.alignment));
+		break;
+	}
+
+	ScopeStatistics& scope_statistics = statistics.scopes[header.scope];
+	scope_statistics.frees++;
+	scope_statistics.current_bytes -= header.size;
+}
+
+char* HostAllocator::allocate_from_arena(size_t size, size_t alignment, uint32_t& offset) {
+	size_t start = arena_head;
+	size_t memory = align_up(start + sizeof(Header), alignment);
+	if (memory + size > arena_size) return nullptr;
+
+	arena_head = memory + size;
+	offset = static_cast<uint32_t>(memory - start);
+	return arena + start;
+}
+
+/**
+ * Slots of a size class are that size, so they're aligned to it (up to the slab's alignment)
+ */
+char* HostAllocator::allocate_from_pool(size_t total_size, uint8_t& size_class) {
+	size_class = 0;
+	size_t slot_size = min_size_class;
+	while (slot_size < total_size) {
+		slot_size *= 2;
+		size_class++;
+	}
+
+	std::vector<char*>& slots = free_slots[size_class];
+	if (slots.empty()) {
+		char* slab = static_cast<char*>(::operator new(slab_size, std::align_val_t(max_pooled_alignment)));
+		slabs.push_back(slab);
+		statistics.pooled_bytes += slab_size;
+		for (size_t i = slab_size / slot_size; i > 0; i--) {
+			slots.push_back(slab + (i - 1) * slot_size);
+		}
+	}
+
+	char* slot = slots.back();
+	slots.pop_back();
+	return slot;
+}
+
+char* HostAllocator::allocate_from_heap(size_t size, size_t alignment, uint32_t& offset) {
+	offset = static_cast<uint32_t>(align_up(sizeof(Header), alignment));
+	return static_cast<char*>(::operator new(offset + size, std::align_val_t(alignment), std::nothrow));
+}
+
+void* VKAPI_PTR HostAllocator::vk_allocate(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return static_cast<HostAllocator*>(user_data)->allocate(size, alignment, scope);
+}
+
+void* VKAPI_PTR HostAllocator::vk_reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+	return static_cast<HostAllocator*>(user_data)->reallocate(original, size, alignment, scope);
+}
+
+void VKAPI_PTR HostAllocator::vk_free(void* user_data, void* memory) {
+	static_cast<HostAllocator*>(user_data)->free(memory);
+}
+
+// Executable memory is the only internal allocation type, so internal bytes are only tracked per scope
+void VKAPI_PTR HostAllocator::vk_internal_allocation(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+	HostAllocator* host_allocator = static_cast<HostAllocator*>(user_data);
+	std::lock_guard<std::mutex> lock(host_allocator->mutex);
+	host_allocator->statistics.scopes[scope].internal_bytes += size;
+}
+
+void VKAPI_PTR HostAllocator::vk_internal_free(void* user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+	HostAllocator* host_allocator = static_cast<HostAllocator*>(user_data);
+	std::lock_guard<std::mutex> lock(host_allocator->mutex);
+	host_allocator->statistics.scopes[scope].internal_bytes -= size;
+}
+
+std::string HostAllocatorStatistics::to_json() const {
+	std::ostringstream json;
+	json << "{\"arena_overflows\":" << arena_overflows << ",\"pooled_bytes\":" << pooled_bytes << ",\"scopes\":{";
+	for (size_t i = 0; i < scopes.size(); i++) {
+		const ScopeStatistics& scope = scopes[i];
+		if (i > 0) json << ",";
+		json << "\"" << scope_name(i) << "\":{"
+			<< "\"current_bytes\":" << scope.current_bytes
+			<< ",\"peak_bytes\":" << scope.peak_bytes
+			<< ",\"allocations\":" << scope.allocations
+			<< ",\"reallocations\":" << scope.reallocations
+			<< ",\"frees\":" << scope.frees
+			<< ",\"internal_bytes\":" << scope.internal_bytes
+			<< "}";
+	}
+	json << "}}";
+	return json.str();
+}
@@ -1,25 +1,94 @@
 #include "Image.h"
 
 #include "Logger.h"
+#include "Type.h"
+#include "Helper.h"
+#include "CommandBuffer.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
+#include "UploadManager.h"
 
-Image::Image(const Device& device, VkImage vk_image, const VkFormat format, ImageType image_type) : device(device), image(vk_image), manage_image_memory(false) {
+Image::Image(const Device& device, VkImage vk_image, const VkFormat format, ImageType image_type) : device(device), image(vk_image), manage_image_memory(false), format(format), image_type(image_type) {
+	states.resize(mip_levels * array_layers);
 	create_image_view(format, image_type);
 }
 
-Image::Image(const Device &device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type) : device(device), manage_image_memory(true) {
+/**
+ * Transient images are attachments which never leave a render pass. Where the device has lazily allocated
+ * memory they're backed by it, so tile-based GPUs may never commit any memory for them
+ */
+Image::Image(const Device &device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type, bool transient) :
+	device(device), manage_image_memory(true), format(format), width(width), height(height), image_type(image_type), transient(transient)
+{
+	states.resize(mip_levels * array_layers);
+	VkMemoryRequirements requirements;
+	create_image(requirements);
+
+	VkMemoryPropertyFlags memory_properties = MemoryProperties::DeviceLocal;
+	if (transient && device.physical_device.has_memory_type(requirements.memoryTypeBits, MemoryProperties::DeviceLocal | MemoryProperties::LazilyAllocated)) {
+		memory_properties |= MemoryProperties::LazilyAllocated;
+	}
+
+	MemoryCategory category = image_type == ImageType::COLOUR ? MemoryCategory::TEXTURE : MemoryCategory::DEPTH;
+	DedicatedResource dedicated = device.get_allocator().query_dedicated(image);
+	allocation = device.get_allocator().allocate(requirements, memory_properties, AllocationTiling::OPTIMAL, category, 0, dedicated);
+
+	vkBindImageMemory(device.get(), image, allocation.memory, allocation.offset);
+
+	create_image_view(format, image_type);
+}
+
+/**
+ * Creates an image without any memory, so it can share memory with images which are never used at the same
+ * time. Bind it with bind_memory before use - the memory stays owned by whoever allocated it
+ */
+Image::Image(const Device& device, const VkFormat format, uint32_t width, uint32_t height, ImageType image_type, VkImageUsageFlags usage) :
+	device(device), manage_image_memory(true), aliased(true), format(format), width(width), height(height), image_type(image_type), usage(usage)
+{
+	states.resize(mip_levels * array_layers);
+	VkMemoryRequirements requirements;
+	create_image(requirements);
+}
+
+/**
+ * Creates an image like source, bound to a new allocation. Used as the destination of a move
+ */
+Image::Image(const Image& source, const Allocation& allocation) :
+	device(source.device), allocation(allocation), manage_image_memory(true), format(source.format), width(source.width), height(source.height), image_type(source.image_type), transient(source.transient)
+{
+	states.resize(mip_levels * array_layers);
+	VkMemoryRequirements requirements;
+	create_image(requirements);
+	vkBindImageMemory(device.get(), image, allocation.memory, allocation.offset);
+	create_image_view(format, image_type);
+}
+
+void Image::create_image(VkMemoryRequirements& requirements) {
 	VkImageCreateInfo image_info {};
 	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	image_info.imageType = VK_IMAGE_TYPE_2D;
 	image_info.extent.width = width;
 	image_info.extent.height = height;
 	image_info.extent.depth = 1;
-	image_info.mipLevels = 1;
-	image_info.arrayLayers = 1;
+	image_info.mipLevels = mip_levels;
+	image_info.arrayLayers = array_layers;
 	image_info.format = format;
 	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
 	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	if (image_type == ImageType::COLOUR) {
-		image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	if (usage != 0) {
+		image_info.usage = usage;
+	}
+	else if (transient) {
+		if (image_type == ImageType::COLOUR) {
+			image_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+		else {
+			image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+	}
+	else if (image_type == ImageType::COLOUR) {
+		// Transfer source so the defragmenter can copy it somewhere else
+		image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	}
 	else if (image_type == ImageType::DEPTH) {
 		image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
@@ -31,34 +100,30 @@ Image::Image(const Device &device, const VkFormat format, uint32_t width, uint32
 	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 	image_info.flags = 0; // Optional
 
-	if (vkCreateImage(device.get(), &image_info, nullptr, &image) != VK_SUCCESS) {
+	if (vkCreateImage(device.get(), &image_info, HostAllocator::callbacks(), &image) != VK_SUCCESS) {
 		throw std::runtime_error("Unable to create image");
 	}
 
-	VkMemoryRequirements requirements;
 	vkGetImageMemoryRequirements(device.get(), image, &requirements);
-
-	VkMemoryAllocateInfo allocate_info{};
-	allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocate_info.allocationSize = requirements.size;
-	allocate_info.memoryTypeIndex = device.physical_device.find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-	if (vkAllocateMemory(device.get(), &allocate_info, nullptr, &memory) != VK_SUCCESS) {
-		throw std::runtime_error("Unable to allocate image memory");
-	}
-
-	vkBindImageMemory(device.get(), image, memory, 0);
-
-	create_image_view(format, image_type);
 }
 
 Image::~Image() {
 	Logger::log("Freeing Image", Logger::VERBOSE);
-	vkDestroyImageView(device.get(), image_view, nullptr);
-	if (manage_image_memory) {
-		vkDestroyImage(device.get(), image, nullptr);
-		vkFreeMemory(device.get(), memory, nullptr);
+	if (movable) {
+		device.get_allocator().release_owner(allocation, this);
 	}
+	if (device.get_upload_manager() != nullptr) {
+		device.get_upload_manager()->cancel(*this);
+	}
+
+	// Frames in flight may still be using it
+	device.get_deletion_queue().push([vk_device = device.get(), image = image, image_view = image_view, allocation = allocation, allocator = &device.get_allocator(), manage_image_memory = manage_image_memory, aliased = aliased]() mutable {
+		vkDestroyImageView(vk_device, image_view, HostAllocator::callbacks());
+		if (manage_image_memory) {
+			vkDestroyImage(vk_device, image, HostAllocator::callbacks());
+			if (!aliased) allocator->free(allocation);
+		}
+	});
 }
 
 const VkImage Image::get() const {
@@ -69,6 +134,98 @@ const VkImageView Image::get_view() const {
 	return image_view;
 }
 
+bool Image::is_transient() const {
+	return transient;
+}
+
+VkMemoryRequirements Image::get_memory_requirements() const {
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device.get(), image, &requirements);
+	return requirements;
+}
+
+void Image::bind_memory(const Allocation& allocation) {
+	if (!aliased || image_view != VK_NULL_HANDLE) {
+		throw std::runtime_error("Only unbound aliased images can be bound to memory");
+	}
+
+	this->allocation = allocation;
+	vkBindImageMemory(device.get(), image, allocation.memory, allocation.offset);
+	create_image_view(format, image_type);
+}
+
+VkImageAspectFlags Image::get_aspect() const {
+	if (image_type == ImageType::COLOUR) return VK_IMAGE_ASPECT_COLOR_BIT;
+
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (has_stencil(format)) aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	return aspect;
+}
+
+uint32_t Image::get_mip_levels() const {
+	return mip_levels;
+}
+
+uint32_t Image::get_array_layers() const {
+	return array_layers;
+}
+
+const ImageState& Image::get_state(uint32_t mip_level, uint32_t array_layer) const {
+	return states.at(array_layer * mip_levels + mip_level);
+}
+
+/**
+ * Only call directly for transitions Vulkan makes itself, such as render pass final layouts
+ */
+void Image::set_state(const ImageState& state, uint32_t mip_level, uint32_t array_layer) {
+	states.at(array_layer * mip_levels + mip_level) = state;
+}
+
+/**
+ * Lets the defragmenter move this image. Only sampled colour images can be moved, and only once
+ * they're in SHADER_READ_ONLY_OPTIMAL, since that's the layout the move expects
+ */
+void Image::enable_defragmentation() {
+	if (!manage_image_memory || image_type != ImageType::COLOUR || transient || aliased || movable) return;
+
+	movable = true;
+	device.get_allocator().set_owner(allocation, this);
+}
+
+const Allocation& Image::get_allocation() const {
+	return allocation;
+}
+
+void Image::record_move(CommandBuffer& command_buffer, const Allocation& new_allocation) {
+	moved_image = std::unique_ptr<Image>(new Image(*this, new_allocation));
+
+	// Both go back to how this image was being used, and the barriers back are batched with the next move's
+	ImageState state = get_state();
+	command_buffer.cmd_transition_image(*this, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	command_buffer.cmd_transition_image(*moved_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+	command_buffer.cmd_copy_image(*this, *moved_image, width, height);
+	command_buffer.cmd_transition_image(*this, state);
+	command_buffer.cmd_transition_image(*moved_image, state);
+}
+
+/**
+ * Swaps in the moved image, view and memory. The returned image holds the old ones
+ */
+std::unique_ptr<Defragmentable> Image::finish_move() {
+	MemoryAllocator& allocator = device.get_allocator();
+	allocator.set_owner(allocation, nullptr);
+	std::swap(image, moved_image->image);
+	std::swap(image_view, moved_image->image_view);
+	std::swap(allocation, moved_image->allocation);
+	std::swap(states, moved_image->states);
+	allocator.set_owner(allocation, this);
+	return std::move(moved_image);
+}
+
+void Image::cancel_move() {
+	moved_image.reset();
+}
+
 void Image::create_image_view(const VkFormat format, ImageType image_type) {
 	VkImageViewCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -93,7 +250,42 @@ void Image::create_image_view(const VkFormat format, ImageType image_type) {
 	create_info.subresourceRange.baseArrayLayer = 0;
 	create_info.subresourceRange.layerCount = 1;
 
-	if (vkCreateImageView(device.get(), &create_info, nullptr, &image_view) != VK_SUCCESS) {
+	if (vkCreateImageView(device.get(), &create_info, HostAllocator::callbacks(), &image_view) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create view for image");
 	}
-}
\ No newline at end of file
+}
+
+/**
+ * The stages and accesses an image in layout is normally used with. Pass a full ImageState instead where
+ * the use is narrower, such as an image only sampled in the vertex shader
+ */
+ImageState ImageState::for_layout(VkImageLayout layout) {
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+		return { layout, PipelineStage::TopOfPipe, 0 };
+	case VK_IMAGE_LAYOUT_GENERAL:
+		return { layout, PipelineStage::ComputeShader, PipelineAccess::ShaderRead | PipelineAccess::ShaderWrite };
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		return { layout, PipelineStage::ColourAttachmentOutput, PipelineAccess::ColourAttachmentRead | PipelineAccess::ColourAttachmentWrite };
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		return { layout, PipelineStage::EarlyFragmentTest | PipelineStage::LateFragmentTest, PipelineAccess::DepthStencilAttachmentRead | PipelineAccess::DepthStencilAttachmentWrite };
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+		return { layout, PipelineStage::EarlyFragmentTest | PipelineStage::FragmentShader, PipelineAccess::DepthStencilAttachmentRead | PipelineAccess::ShaderRead };
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		return { layout, PipelineStage::FragmentShader | PipelineStage::ComputeShader, PipelineAccess::ShaderRead };
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		return { layout, PipelineStage::TransferBit, PipelineAccess::TransferRead };
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		return { layout, PipelineStage::TransferBit, PipelineAccess::TransferWrite };
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		return { layout, PipelineStage::BottomOfPipe, 0 };
+	default:
+		throw std::invalid_argument("No default access for image layout " + std::to_string(layout));
+	}
+}
+
+bool ImageState::is_read_only() const {
+	constexpr VkAccessFlags writes = PipelineAccess::ShaderWrite | PipelineAccess::ColourAttachmentWrite | PipelineAccess::DepthStencilAttachmentWrite |
+		PipelineAccess::TransferWrite | PipelineAccess::HostWrite | PipelineAccess::MemoryWrite;
+	return (access & writes) == 0;
+}
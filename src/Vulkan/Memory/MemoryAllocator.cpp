@@ -0,0 +1,607 @@
+#include "MemoryAllocator.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+#include <sstream>
+
+#include "Device.h"
+#include "Logger.h"
+#include "Type.h"
+#include "Defragmenter.h"
+#include "HostAllocator.h"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Checks whether the end of resource A and the start of resource B fall in the same page
+ * of size page_size (bufferImageGranularity)
+ */
+static bool on_same_page(VkDeviceSize a_offset, VkDeviceSize a_size, VkDeviceSize b_offset, VkDeviceSize page_size) {
+	VkDeviceSize a_end_page = (a_offset + a_size - 1) / page_size;
+	VkDeviceSize b_start_page = b_offset / page_size;
+	return a_end_page == b_start_page;
+}
+
+/**
+ * Given a resource, the memory is allocated for it alone - it must then be the only thing bound, at offset 0
+ */
+MemoryBlock::MemoryBlock(const Device& device, uint32_t memory_type, VkDeviceSize size, bool dedicated, const DedicatedResource& resource) :
+	memory_type(memory_type), size(size), dedicated(dedicated), device(device)
+{
+	VkMemoryAllocateInfo memory_alloc_info{};
+	memory_alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memory_alloc_info.allocationSize = size;
+	memory_alloc_info.memoryTypeIndex = memory_type;
+
+	VkMemoryDedicatedAllocateInfo dedicated_info{};
+	if (resource.buffer != VK_NULL_HANDLE || resource.image != VK_NULL_HANDLE) {
+		dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+		dedicated_info.buffer = resource.buffer;
+		dedicated_info.image = resource.image;
+		memory_alloc_info.pNext = &dedicated_info;
+	}
+
+	if (vkAllocateMemory(device.get(), &memory_alloc_info, HostAllocator::callbacks(), &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate memory");
+	}
+
+	ranges.push_back({ 0, size, true, AllocationTiling::LINEAR });
+}
+
+MemoryBlock::~MemoryBlock() {
+	Logger::log("Freeing Memory Block", Logger::VERBOSE);
+	if (map_count > 0) {
+		vkUnmapMemory(device.get(), memory);
+	}
+	vkFreeMemory(device.get(), memory, HostAllocator::callbacks());
+}
+
+VkDeviceMemory MemoryBlock::get() const {
+	return memory;
+}
+
+/**
+ * First-fit search through the free ranges. Returns the offset of the new range if one fits
+ */
+std::optional<VkDeviceSize> MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, AllocationTiling tiling, VkDeviceSize granularity) {
+	for (size_t i = 0; i < ranges.size(); i++) {
+		Range range = ranges[i];
+		if (!range.free || range.size < size) continue;
+
+		VkDeviceSize offset = align_up(range.offset, alignment);
+
+		// Free ranges are always merged, so neighbours of a free range are in use
+		if (i > 0) {
+			const Range& previous = ranges[i - 1];
+			if (previous.tiling != tiling && on_same_page(previous.offset, previous.size, offset, granularity)) {
+				offset = align_up(offset, granularity);
+			}
+		}
+
+		VkDeviceSize end = offset + size;
+		VkDeviceSize range_end = range.offset + range.size;
+		if (end > range_end) continue;
+
+		if (i + 1 < ranges.size()) {
+			const Range& next = ranges[i + 1];
+			if (next.tiling != tiling && on_same_page(offset, size, next.offset, granularity)) continue;
+		}
+
+		std::vector<Range> split;
+		if (offset > range.offset) split.push_back({ range.offset, offset - range.offset, true, tiling });
+		split.push_back({ offset, size, false, tiling });
+		if (end < range_end) split.push_back({ end, range_end - end, true, tiling });
+
+		ranges.erase(ranges.begin() + i);
+		ranges.insert(ranges.begin() + i, split.begin(), split.end());
+		used_bytes += size;
+		return offset;
+	}
+
+	return std::nullopt;
+}
+
+void MemoryBlock::free(VkDeviceSize offset) {
+	for (size_t i = 0; i < ranges.size(); i++) {
+		if (ranges[i].offset != offset || ranges[i].free) continue;
+
+		ranges[i].free = true;
+		ranges[i].owner = nullptr;
+		used_bytes -= ranges[i].size;
+
+		// Merge with the neighbouring free ranges
+		if (i + 1 < ranges.size() && ranges[i + 1].free) {
+			ranges[i].size += ranges[i + 1].size;
+			ranges.erase(ranges.begin() + i + 1);
+		}
+		if (i > 0 && ranges[i - 1].free) {
+			ranges[i - 1].size += ranges[i].size;
+			ranges.erase(ranges.begin() + i);
+		}
+		return;
+	}
+
+	throw std::runtime_error("Attempted to free a range that isn't allocated in this memory block");
+}
+
+bool MemoryBlock::empty() const {
+	return ranges.size() == 1 && ranges[0].free;
+}
+
+VkDeviceSize MemoryBlock::get_used_bytes() const {
+	return used_bytes;
+}
+
+void MemoryBlock::set_owner(VkDeviceSize offset, Defragmentable* owner) {
+	for (auto& range : ranges) {
+		if (range.offset == offset && !range.free) {
+			range.owner = owner;
+			return;
+		}
+	}
+}
+
+/**
+ * Resources in this block which have registered themselves as movable
+ */
+std::vector<Defragmentable*> MemoryBlock::get_owners() const {
+	std::vector<Defragmentable*> owners;
+	for (auto& range : ranges) {
+		if (range.owner != nullptr) owners.push_back(range.owner);
+	}
+	return owners;
+}
+
+/**
+ * Maps the whole block. Memory can only be mapped once, so every range in the block shares the mapping
+ */
+void* MemoryBlock::map() {
+	if (map_count == 0) {
+		if (vkMapMemory(device.get(), memory, 0, VK_WHOLE_SIZE, 0, &mapped_memory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to map memory block");
+		}
+	}
+	map_count++;
+	return mapped_memory;
+}
+
+void MemoryBlock::unmap() {
+	if (map_count == 0) {
+		throw std::runtime_error("Attempted to unmap a memory block that isn't mapped");
+	}
+	map_count--;
+	if (map_count == 0) {
+		vkUnmapMemory(device.get(), memory);
+		mapped_memory = nullptr;
+	}
+}
+
+MemoryAllocator::MemoryAllocator(const Device& device) : device(device) {
+	memory_properties = device.physical_device.get_memory_properties();
+	buffer_image_granularity = device.physical_device.device_properties.limits.bufferImageGranularity;
+	non_coherent_atom_size = device.physical_device.device_properties.limits.nonCoherentAtomSize;
+
+	// vkGetPhysicalDeviceMemoryProperties2 is core in 1.1, so the device needs that as well as the extension
+	has_memory_budget = device.has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) && VK_API_VERSION_MINOR(device.physical_device.device_properties.apiVersion) >= 1;
+
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+		heap_statistics[i].heap_size = memory_properties.memoryHeaps[i].size;
+		heap_statistics[i].device_local = (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+}
+
+MemoryAllocator::~MemoryAllocator() {
+	Logger::log("Freeing Memory Allocator", Logger::VERBOSE);
+	for (auto& type_blocks : blocks) {
+		for (auto& block : type_blocks) {
+			if (!block->empty()) {
+				Logger::log("Memory block for type " + std::to_string(block->memory_type) + " still has live allocations", Logger::WARN);
+			}
+		}
+		type_blocks.clear();
+	}
+}
+
+std::string MemoryAllocator::category_name(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::VERTEX: return "vertex";
+	case MemoryCategory::INDEX: return "index";
+	case MemoryCategory::UNIFORM: return "uniform";
+	case MemoryCategory::TEXTURE: return "texture";
+	case MemoryCategory::DEPTH: return "depth";
+	case MemoryCategory::STAGING: return "staging";
+	default: return "other";
+	}
+}
+
+/**
+ * Allocates from a memory type with properties, and with preferred_properties too where there is one. Pass the
+ * resource from query_dedicated to give it memory of its own where the driver prefers or requires that
+ */
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, AllocationTiling tiling, MemoryCategory category, VkMemoryPropertyFlags preferred_properties, const DedicatedResource& resource) {
+	uint32_t memory_type = device.physical_device.find_memory_type(requirements.memoryTypeBits, properties, preferred_properties);
+	VkDeviceSize block_size = preferred_block_size(memory_type);
+
+	// Flushes are rounded out to nonCoherentAtomSize, so keep neighbouring allocations out of each other's atoms
+	VkDeviceSize alignment = requirements.alignment;
+	VkMemoryPropertyFlags type_properties = memory_properties.memoryTypes[memory_type].propertyFlags;
+	if ((type_properties & MemoryProperties::HostVisible) && !(type_properties & MemoryProperties::HostCoherent)) {
+		alignment = std::max(alignment, non_coherent_atom_size);
+	}
+
+	auto make_allocation = [&](MemoryBlock& block, VkDeviceSize offset) {
+		return create_allocation(block, offset, requirements.size, alignment, tiling, category);
+	};
+
+	// Large resources (mostly images) get a dedicated allocation instead of eating most of a shared block.
+	// Lazily allocated memory is committed per VkDeviceMemory, so sharing a block would defeat it
+	bool driver_dedicated = resource.prefers_dedicated || resource.requires_dedicated;
+	if (driver_dedicated || requirements.size > block_size / 2 || (type_properties & MemoryProperties::LazilyAllocated)) {
+		// Only tell the driver which resource it's for when it asked, as the block can then hold nothing else
+		MemoryBlock& block = create_block(memory_type, requirements.size, requirements.size, true, driver_dedicated ? resource : DedicatedResource{});
+		std::optional<VkDeviceSize> offset = block.allocate(requirements.size, alignment, tiling, buffer_image_granularity);
+		if (!offset.has_value()) {
+			throw std::runtime_error("Unable to fit allocation in its dedicated memory block");
+		}
+		return make_allocation(block, offset.value());
+	}
+
+	for (auto& block : blocks[memory_type]) {
+		if (block->dedicated) continue;
+
+		std::optional<VkDeviceSize> offset = block->allocate(requirements.size, alignment, tiling, buffer_image_granularity);
+		if (offset.has_value()) {
+			return make_allocation(*block, offset.value());
+		}
+	}
+
+	MemoryBlock& block = create_block(memory_type, block_size, requirements.size + alignment, false);
+	std::optional<VkDeviceSize> offset = block.allocate(requirements.size, alignment, tiling, buffer_image_granularity);
+	if (!offset.has_value()) {
+		throw std::runtime_error("Unable to fit allocation in a new memory block");
+	}
+	return make_allocation(block, offset.value());
+}
+
+/**
+ * Whether the driver prefers or requires the buffer to have memory of its own, to pass on to allocate()
+ */
+DedicatedResource MemoryAllocator::query_dedicated(VkBuffer buffer) const {
+	VkBufferMemoryRequirementsInfo2 requirements_info{};
+	requirements_info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirements_info.buffer = buffer;
+
+	VkMemoryDedicatedRequirements dedicated_requirements{};
+	dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated_requirements;
+	vkGetBufferMemoryRequirements2(device.get(), &requirements_info, &requirements);
+
+	return { buffer, VK_NULL_HANDLE, dedicated_requirements.prefersDedicatedAllocation == VK_TRUE, dedicated_requirements.requiresDedicatedAllocation == VK_TRUE };
+}
+
+DedicatedResource MemoryAllocator::query_dedicated(VkImage image) const {
+	VkImageMemoryRequirementsInfo2 requirements_info{};
+	requirements_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirements_info.image = image;
+
+	VkMemoryDedicatedRequirements dedicated_requirements{};
+	dedicated_requirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 requirements{};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicated_requirements;
+	vkGetImageMemoryRequirements2(device.get(), &requirements_info, &requirements);
+
+	return { VK_NULL_HANDLE, image, dedicated_requirements.prefersDedicatedAllocation == VK_TRUE, dedicated_requirements.requiresDedicatedAllocation == VK_TRUE };
+}
+
+void MemoryAllocator::free(Allocation& allocation) {
+	if (allocation.block == nullptr) return;
+
+	MemoryBlock* block = allocation.block;
+	block->free(allocation.offset);
+
+	HeapStatistics& heap = get_heap_statistics(allocation.memory_type);
+	heap.allocated_bytes -= allocation.size;
+	heap.allocation_count--;
+	heap.category_bytes[static_cast<size_t>(allocation.category)] -= allocation.size;
+	allocation = Allocation{};
+
+	if (!block->empty()) return;
+
+	// Keep one empty shared block around per memory type so we don't thrash vkAllocateMemory
+	size_t shared_blocks = 0;
+	for (auto& type_block : blocks[block->memory_type]) {
+		if (!type_block->dedicated) shared_blocks++;
+	}
+	if (block->dedicated || shared_blocks > 1) {
+		release_block(block);
+	}
+}
+
+void* MemoryAllocator::map(const Allocation& allocation) {
+	if (allocation.block == nullptr) {
+		throw std::runtime_error("Attempted to map an empty allocation");
+	}
+	return static_cast<char*>(allocation.block->map()) + allocation.offset;
+}
+
+void MemoryAllocator::unmap(const Allocation& allocation) {
+	if (allocation.block == nullptr) {
+		throw std::runtime_error("Attempted to unmap an empty allocation");
+	}
+	allocation.block->unmap();
+}
+
+bool MemoryAllocator::is_coherent(const Allocation& allocation) const {
+	return (memory_properties.memoryTypes[allocation.memory_type].propertyFlags & MemoryProperties::HostCoherent) != 0;
+}
+
+/**
+ * Converts a range within an allocation to a flushable range of its memory, rounded out to nonCoherentAtomSize
+ */
+VkMappedMemoryRange MemoryAllocator::get_mapped_range(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size) const {
+	VkDeviceSize start = allocation.offset + offset;
+	VkDeviceSize end = allocation.offset + std::min(offset + size, allocation.size);
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.memory;
+	range.offset = start / non_coherent_atom_size * non_coherent_atom_size;
+	VkDeviceSize aligned_end = align_up(end, non_coherent_atom_size);
+	range.size = aligned_end >= allocation.block->size ? VK_WHOLE_SIZE : aligned_end - range.offset;
+	return range;
+}
+
+void MemoryAllocator::set_owner(const Allocation& allocation, Defragmentable* owner) {
+	if (allocation.block == nullptr) return;
+	allocation.block->set_owner(allocation.offset, owner);
+}
+
+/**
+ * Called when a movable resource is destroyed, so any move in progress can be cancelled first
+ */
+void MemoryAllocator::release_owner(const Allocation& allocation, Defragmentable* owner) {
+	set_owner(allocation, nullptr);
+	if (defragmenter != nullptr) {
+		defragmenter->cancel(owner);
+	}
+}
+
+/**
+ * Called before a movable resource is written, so a move in progress doesn't swap in a stale copy
+ */
+void MemoryAllocator::notify_written(Defragmentable* owner) {
+	if (defragmenter != nullptr) {
+		defragmenter->invalidate(owner);
+	}
+}
+
+void MemoryAllocator::set_defragmenter(Defragmenter* defragmenter) {
+	this->defragmenter = defragmenter;
+}
+
+/**
+ * The shared block of a memory type with the least memory in use, as long as there's another
+ * block its contents could move into. Emptying it lets the allocator give it back to the driver
+ */
+MemoryBlock* MemoryAllocator::find_sparsest_block(uint32_t memory_type) const {
+	MemoryBlock* sparsest = nullptr;
+	uint32_t used_blocks = 0;
+	for (auto& block : blocks[memory_type]) {
+		if (block->dedicated || block->empty()) continue;
+		used_blocks++;
+		if (sparsest == nullptr || block->get_used_bytes() < sparsest->get_used_bytes()) {
+			sparsest = block.get();
+		}
+	}
+	return used_blocks > 1 ? sparsest : nullptr;
+}
+
+/**
+ * Finds space for an existing allocation in another shared block of the same memory type, fullest
+ * block first. Never creates new blocks, since the point is to pack existing ones
+ */
+std::optional<Allocation> MemoryAllocator::reallocate(const Allocation& allocation, const MemoryBlock* excluded_block) {
+	std::vector<MemoryBlock*> candidates;
+	for (auto& block : blocks[allocation.memory_type]) {
+		if (block->dedicated || block.get() == excluded_block) continue;
+		candidates.push_back(block.get());
+	}
+	std::sort(candidates.begin(), candidates.end(), [](MemoryBlock* a, MemoryBlock* b) {
+		return a->get_used_bytes() > b->get_used_bytes();
+	});
+
+	for (MemoryBlock* block : candidates) {
+		std::optional<VkDeviceSize> offset = block->allocate(allocation.size, allocation.alignment, allocation.tiling, buffer_image_granularity);
+		if (offset.has_value()) {
+			return create_allocation(*block, offset.value(), allocation.size, allocation.alignment, allocation.tiling, allocation.category);
+		}
+	}
+	return std::nullopt;
+}
+
+/**
+ * Bumped whenever resources have moved, so anything holding their old handles (e.g. descriptor sets) knows to refresh
+ */
+void MemoryAllocator::notify_moved() {
+	move_generation++;
+}
+
+uint64_t MemoryAllocator::get_move_generation() const {
+	return move_generation;
+}
+
+/**
+ * Snapshot of the memory used by every heap. With VK_EXT_memory_budget the budget and usage are
+ * the driver's numbers for the whole process, which includes memory this allocator doesn't own
+ */
+MemoryStatistics MemoryAllocator::get_statistics() const {
+	MemoryStatistics statistics{};
+	statistics.has_memory_budget = has_memory_budget;
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+		statistics.heaps.push_back(measure_heap(i));
+	}
+	return statistics;
+}
+
+/**
+ * Whether a resource with these requirements can go in memory which is both device local and host visible, as
+ * on integrated GPUs and discrete GPUs with resizable BAR. The data can then be written directly instead of
+ * staged. Leaves room for a new block in the heap's budget, so this returns false well before the heap runs out
+ */
+bool MemoryAllocator::has_direct_write_memory(const VkMemoryRequirements& requirements) const {
+	const VkMemoryPropertyFlags direct_write = MemoryProperties::DeviceLocal | MemoryProperties::HostVisible;
+	if (!device.physical_device.has_memory_type(requirements.memoryTypeBits, direct_write)) return false;
+
+	// The type allocate() will pick, so its heap is the one which needs room
+	uint32_t memory_type = device.physical_device.find_memory_type(requirements.memoryTypeBits, direct_write);
+	HeapStatistics heap = measure_heap(memory_properties.memoryTypes[memory_type].heapIndex);
+	return heap.usage + requirements.size + preferred_block_size(memory_type) <= heap.budget;
+}
+
+/**
+ * The heap's statistics with its current budget and usage. Without VK_EXT_memory_budget that's the heap's size
+ * and what this allocator has taken from it
+ */
+HeapStatistics MemoryAllocator::measure_heap(uint32_t heap_index) const {
+	HeapStatistics heap = heap_statistics[heap_index];
+	if (!has_memory_budget) {
+		heap.budget = heap.heap_size;
+		heap.usage = heap.block_bytes;
+		return heap;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties{};
+	budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	properties.pNext = &budget_properties;
+	vkGetPhysicalDeviceMemoryProperties2(device.physical_device.get(), &properties);
+
+	heap.budget = budget_properties.heapBudget[heap_index];
+	heap.usage = budget_properties.heapUsage[heap_index];
+	return heap;
+}
+
+/**
+ * Small heaps (e.g. the 256MiB device local + host visible heap) get smaller blocks so one block can't take it over
+ */
+VkDeviceSize MemoryAllocator::preferred_block_size(uint32_t memory_type) const {
+	uint32_t heap_index = memory_properties.memoryTypes[memory_type].heapIndex;
+	VkDeviceSize heap_size = memory_properties.memoryHeaps[heap_index].size;
+	const VkDeviceSize small_heap_size = 1024ull * 1024 * 1024;
+	return heap_size <= small_heap_size ? heap_size / 8 : default_block_size;
+}
+
+MemoryBlock& MemoryAllocator::create_block(uint32_t memory_type, VkDeviceSize size, VkDeviceSize minimum_size, bool dedicated, const DedicatedResource& resource) {
+	if (allocation_count >= device.physical_device.device_properties.limits.maxMemoryAllocationCount) {
+		throw std::runtime_error("Exceeded maxMemoryAllocationCount");
+	}
+
+	log_budget_warning(memory_type, size);
+
+	// If the heap can't fit a full block, try smaller blocks before giving up
+	VkDeviceSize block_size = size;
+	while (true) {
+		try {
+			blocks[memory_type].push_back(std::make_unique<MemoryBlock>(device, memory_type, block_size, dedicated, resource));
+			break;
+		} catch (const std::runtime_error&) {
+			if (block_size / 2 < minimum_size) throw;
+			block_size /= 2;
+		}
+	}
+	allocation_count++;
+
+	HeapStatistics& heap = get_heap_statistics(memory_type);
+	heap.block_bytes += block_size;
+	heap.block_count++;
+
+	Logger::log("Allocated " + std::string(dedicated ? "dedicated " : "") + "memory block of " + std::to_string(block_size) + " bytes for memory type " + std::to_string(memory_type), Logger::VERBOSE);
+	return *blocks[memory_type].back();
+}
+
+void MemoryAllocator::release_block(MemoryBlock* block) {
+	auto& type_blocks = blocks[block->memory_type];
+	for (auto it = type_blocks.begin(); it != type_blocks.end(); it++) {
+		if (it->get() == block) {
+			HeapStatistics& heap = get_heap_statistics(block->memory_type);
+			heap.block_bytes -= block->size;
+			heap.block_count--;
+
+			type_blocks.erase(it);
+			allocation_count--;
+			return;
+		}
+	}
+}
+
+Allocation MemoryAllocator::create_allocation(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size, VkDeviceSize alignment, AllocationTiling tiling, MemoryCategory category) {
+	Allocation allocation{};
+	allocation.memory = block.get();
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.memory_type = block.memory_type;
+	allocation.alignment = alignment;
+	allocation.tiling = tiling;
+	allocation.category = category;
+	allocation.block = &block;
+
+	HeapStatistics& heap = get_heap_statistics(block.memory_type);
+	heap.allocated_bytes += allocation.size;
+	heap.allocation_count++;
+	heap.category_bytes[static_cast<size_t>(category)] += allocation.size;
+	return allocation;
+}
+
+HeapStatistics& MemoryAllocator::get_heap_statistics(uint32_t memory_type) {
+	return heap_statistics[memory_properties.memoryTypes[memory_type].heapIndex];
+}
+
+void MemoryAllocator::log_budget_warning(uint32_t memory_type, VkDeviceSize size) const {
+	uint32_t heap_index = memory_properties.memoryTypes[memory_type].heapIndex;
+	HeapStatistics heap = measure_heap(heap_index);
+	if (heap.usage + size > heap.budget) {
+		Logger::log("Allocating " + std::to_string(size) + " bytes takes heap " + std::to_string(heap_index) + " over its budget of " + std::to_string(heap.budget) + " bytes", Logger::WARN);
+	}
+}
+
+VkDeviceSize MemoryStatistics::get_category_bytes(MemoryCategory category) const {
+	VkDeviceSize bytes = 0;
+	for (auto& heap : heaps) {
+		bytes += heap.category_bytes[static_cast<size_t>(category)];
+	}
+	return bytes;
+}
+
+std::string MemoryStatistics::to_json() const {
+	std::ostringstream json;
+	json << "{\"has_memory_budget\":" << (has_memory_budget ? "true" : "false") << ",\"heaps\":[";
+	for (size_t i = 0; i < heaps.size(); i++) {
+		const HeapStatistics& heap = heaps[i];
+		if (i > 0) json << ",";
+		json << "{\"index\":" << i
+			<< ",\"device_local\":" << (heap.device_local ? "true" : "false")
+			<< ",\"heap_size\":" << heap.heap_size
+			<< ",\"budget\":" << heap.budget
+			<< ",\"usage\":" << heap.usage
+			<< ",\"block_bytes\":" << heap.block_bytes
+			<< ",\"block_count\":" << heap.block_count
+			<< ",\"allocated_bytes\":" << heap.allocated_bytes
+			<< ",\"allocation_count\":" << heap.allocation_count
+			<< ",\"categories\":{";
+		for (size_t category = 0; category < heap.category_bytes.size(); category++) {
+			if (category > 0) json << ",";
+			json << "\"" << MemoryAllocator::category_name(static_cast<MemoryCategory>(category)) << "\":" << heap.category_bytes[category];
+		}
+		json << "}}";
+	}
+	json << "]}";
+	return json.str();
+}
@@ -1,6 +1,9 @@
 #include "Sampler.h"
 
-Sampler::Sampler(const Device& device) : device(device) {
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
+
+Sampler::Sampler(const Device& device, VkSamplerAddressMode address_mode) : device(device) {
 	VkPhysicalDeviceProperties properties = device.physical_device.device_properties;
 	VkPhysicalDeviceFeatures features = device.physical_device.device_features;
 
@@ -8,9 +11,9 @@ Sampler::Sampler(const Device& device) : device(device) {
 	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	sampler_info.magFilter = VK_FILTER_LINEAR;
 	sampler_info.minFilter = VK_FILTER_LINEAR;
-	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	sampler_info.addressModeU = address_mode;
+	sampler_info.addressModeV = address_mode;
+	sampler_info.addressModeW = address_mode;
 	sampler_info.anisotropyEnable = features.samplerAnisotropy;
 	sampler_info.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
 	sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
@@ -22,13 +25,15 @@ Sampler::Sampler(const Device& device) : device(device) {
 	sampler_info.minLod = 0.0f;
 	sampler_info.maxLod = 0.0f;
 
-	if (vkCreateSampler(device.get(), &sampler_info, nullptr, &sampler) != VK_SUCCESS) {
+	if (vkCreateSampler(device.get(), &sampler_info, HostAllocator::callbacks(), &sampler) != VK_SUCCESS) {
 		throw std::runtime_error("Unable to create sampler");
 	}
 }
 
 Sampler::~Sampler() {
-	vkDestroySampler(device.get(), sampler, nullptr);
+	device.get_deletion_queue().push([vk_device = device.get(), sampler = sampler]() {
+		vkDestroySampler(vk_device, sampler, HostAllocator::callbacks());
+	});
 }
 
 VkSampler Sampler::get() const {
@@ -0,0 +1,82 @@
+#include "UniformRingBuffer.h"
+
+#include <stdexcept>
+
+#include "Type.h"
+
+UniformRingBuffer::UniformRingBuffer(Device& device, VkDeviceSize frame_size, uint32_t frames) : frame_size(frame_size), device(device) {
+	alignment = get_alignment(device);
+
+	// Prefer memory the GPU reads locally when the host can also write to it, otherwise cached host memory
+	VkMemoryPropertyFlags memory_properties = MemoryProperties::HostVisible;
+	VkMemoryPropertyFlags preferred_properties = MemoryProperties::HostCached;
+	VkMemoryRequirements requirements = Buffer::query_memory_requirements(device, frame_size, BufferUsage::Uniform);
+	requirements.size *= frames;
+	if (device.get_allocator().has_direct_write_memory(requirements)) {
+		memory_properties |= MemoryProperties::DeviceLocal;
+		preferred_properties = 0;
+	}
+
+	for (uint32_t i = 0; i < frames; i++) {
+		buffers.push_back(Buffer::create_empty_buffer(device, frame_size, BufferUsage::Uniform, memory_properties, LocalMemory::Persistent, preferred_properties));
+	}
+}
+
+/**
+ * Size a frame needs to hold element_count allocations of element_size once they're aligned
+ */
+VkDeviceSize UniformRingBuffer::frame_size_for(const Device& device, VkDeviceSize element_size, uint32_t element_count) {
+	VkDeviceSize alignment = get_alignment(device);
+	return (element_size + alignment - 1) / alignment * alignment * element_count;
+}
+
+/**
+ * Resets the buffer for the given frame. Only call once that frame's previous submission has finished
+ */
+void UniformRingBuffer::begin_frame(uint32_t frame) {
+	if (frame >= buffers.size()) {
+		throw std::runtime_error("Uniform ring buffer frame out of range");
+	}
+
+	current_frame = frame;
+	head = 0;
+}
+
+/**
+ * Reserves size bytes in the current frame's buffer and returns the dynamic offset
+ */
+uint32_t UniformRingBuffer::allocate(VkDeviceSize size) {
+	VkDeviceSize offset = head;
+	if (offset + size > frame_size) {
+		throw std::runtime_error("Uniform ring buffer is full - increase the frame size");
+	}
+
+	head = offset + aligned_size(size);
+	return static_cast<uint32_t>(offset);
+}
+
+uint32_t UniformRingBuffer::push(const void* data, VkDeviceSize size) {
+	uint32_t offset = allocate(size);
+	buffers.at(current_frame).fill_buffer(data, size, offset);
+	return offset;
+}
+
+VkDeviceSize UniformRingBuffer::aligned_size(VkDeviceSize size) const {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Flushes everything pushed this frame. Call once after the frame's pushes, before submitting
+ */
+void UniformRingBuffer::flush() {
+	buffers.at(current_frame).flush();
+}
+
+boost::ptr_vector<Buffer>* UniformRingBuffer::get_buffers() {
+	return &buffers;
+}
+
+VkDeviceSize UniformRingBuffer::get_alignment(const Device& device) {
+	VkDeviceSize alignment = device.physical_device.device_properties.limits.minUniformBufferOffsetAlignment;
+	return alignment == 0 ? 1 : alignment;
+}
@@ -0,0 +1,342 @@
+#include "UploadManager.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <stb_image.h>
+
+#include "CommandPool.h"
+#include "CommandBuffer.h"
+#include "Queue.h"
+#include "Logger.h"
+#include "Type.h"
+#include "ResourcePools.h"
+#include "AllocationTracker.h"
+
+UploadManager::UploadManager(Device& device, CommandPool& command_pool, Queue& queue, VkDeviceSize staging_size) :
+	staging_size(staging_size), device(device), command_pool(command_pool), queue(queue),
+	graphics_family(device.queues.at(GRAPHICS)->queue_family.index)
+{
+	if (command_pool.get_queue_family_index() != queue.queue_family.index) {
+		throw std::invalid_argument("Upload command pool must be for the upload queue's family");
+	}
+
+	// Image copies need offsets that are a multiple of the texel size, 16 covers every colour format
+	staging_alignment = std::max<VkDeviceSize>(16, device.physical_device.device_properties.limits.optimalBufferCopyOffsetAlignment);
+	// Cached memory is quicker for the host to work in, and non-coherent types are flushed anyway
+	staging_buffer = Buffer::create_empty_buffer(device, staging_size, BufferUsage::TransferSource, MemoryProperties::HostVisible, LocalMemory::Persistent, MemoryProperties::HostCached);
+	device.set_upload_manager(this);
+}
+
+UploadManager::~UploadManager() {
+	Logger::log("Freeing Upload Manager", Logger::VERBOSE);
+	device.set_upload_manager(nullptr);
+	while (!batches.empty()) {
+		retire_batches(true);
+	}
+}
+
+/**
+ * Writes data at destination_offset. Where uploads change queue family, a buffer which has been uploaded to before
+ * can only be written whole, since rewriting part of it without owning it would leave the rest undefined
+ */
+UploadTicket UploadManager::upload_buffer(Buffer& destination, const void* data, VkDeviceSize data_size, VkDeviceSize destination_offset) {
+	if (transfers_ownership()) {
+		bool partial = destination_offset != 0 || data_size != destination.get_size();
+		if (partial && graphics_owned_buffers.contains(&destination)) {
+			throw std::invalid_argument("Can't upload part of a buffer the graphics family owns - upload the whole buffer");
+		}
+		graphics_owned_buffers.insert(&destination);
+	}
+
+	device.get_allocator().notify_written(&destination);
+	PendingUpload& upload = stage(data, data_size);
+	upload.destination_buffer = &destination;
+	upload.destination_offset = destination_offset;
+	return upload.ticket;
+}
+
+/**
+ * Creates a device local buffer holding data. Where device local memory is host visible (integrated GPUs,
+ * resizable BAR) and its heap has room, the data is written straight into it with no copy or submit.
+ * Otherwise it falls back to a staged upload
+ */
+std::pair<Handle<Buffer>, UploadTicket> UploadManager::create_buffer(const void* data, VkDeviceSize data_size, VkBufferUsageFlags buffer_usage) {
+	ResourcePool<Buffer>& buffers = device.get_resources().buffers;
+
+	VkMemoryRequirements requirements = Buffer::query_memory_requirements(device, data_size, buffer_usage);
+	if (device.get_allocator().has_direct_write_memory(requirements)) {
+		Handle<Buffer> buffer = buffers.create(device, data_size, buffer_usage, MemoryProperties::DeviceLocal | MemoryProperties::HostVisible, LocalMemory::Dynamic);
+		buffers.get(buffer).fill_buffer(data, data_size);
+		return std::make_pair(buffer, immediate_ticket);
+	}
+
+	Handle<Buffer> buffer = buffers.create(device, data_size, buffer_usage | BufferUsage::TransferDestination, MemoryProperties::DeviceLocal, LocalMemory::Dynamic);
+	UploadTicket ticket = upload_buffer(buffers.get(buffer), data, data_size);
+	return std::make_pair(buffer, ticket);
+}
+
+UploadTicket UploadManager::upload_image(Image& destination, VkFormat format, const void* data, VkDeviceSize data_size, uint32_t width, uint32_t height) {
+	device.get_allocator().notify_written(&destination);
+	PendingUpload& upload = stage(data, data_size);
+	upload.destination_image = &destination;
+	upload.format = format;
+	upload.width = width;
+	upload.height = height;
+	return upload.ticket;
+}
+
+std::pair<Handle<Image>, UploadTicket> UploadManager::load_image(const std::string& image_path, VkFormat format) {
+	int tex_width, tex_height, tex_channels;
+	stbi_uc* image_data = stbi_load(image_path.c_str(), &tex_width, &tex_height, &tex_channels, STBI_rgb_alpha);
+
+	if (!image_data) {
+		throw std::runtime_error("Failed to load texture from " + image_path);
+	}
+
+	VkDeviceSize image_size = static_cast<VkDeviceSize>(tex_width) * tex_height * 4;
+	Handle<Image> image = device.get_resources().images.create(device, format, tex_width, tex_height);
+	UploadTicket ticket = upload_image(device.get_resources().images.get(image), format, image_data, image_size, tex_width, tex_height);
+	stbi_image_free(image_data);
+
+	return std::make_pair(image, ticket);
+}
+
+/**
+ * Retires finished batches, then submits queued uploads until byte_budget is used up.
+ * At least one upload is always submitted so uploads larger than the budget still make progress
+ */
+void UploadManager::update(VkDeviceSize byte_budget) {
+	AllocationSite site("UploadManager::update");
+	retire_batches(false);
+	submit_pending(byte_budget);
+}
+
+void UploadManager::flush() {
+	submit_pending(UINT64_MAX);
+}
+
+void UploadManager::wait_idle() {
+	flush();
+	while (!batches.empty()) {
+		retire_batches(true);
+	}
+}
+
+bool UploadManager::is_complete(UploadTicket ticket) const {
+	return ticket <= completed_ticket;
+}
+
+/**
+ * Records the graphics half of the ownership transfers for every finished upload. Call it each frame before
+ * recording anything which uses uploaded resources - a ticket reported complete is acquired by the next call.
+ *
+ * Where uploads run on another queue, the graphics submit must also wait on the returned TimelineWait. The host
+ * having seen the batch finish doesn't order the GPU's reads after the copies, the semaphore wait does, and it
+ * makes the copies visible too. Only uploads on the graphics queue itself have no wait, so get a barrier instead
+ */
+std::optional<TimelineWait> UploadManager::acquire(CommandBuffer& graphics_command_buffer) {
+	if (acquirable_value == 0) return std::nullopt;
+
+	bool graphics_queue = &queue == device.queues.at(GRAPHICS).get();
+	if (graphics_queue) {
+		graphics_command_buffer.cmd_memory_barrier(PipelineStage::TransferBit, PipelineStage::AllCommands, PipelineAccess::TransferWrite, PipelineAccess::MemoryRead);
+	}
+
+	uint32_t transfer_family = queue.queue_family.index;
+	for (Buffer* buffer : acquirable_buffers) {
+		// Uploaded buffers could be read as vertices, indices, uniforms or storage, so wait on any read
+		graphics_command_buffer.cmd_acquire_buffer(*buffer, transfer_family, PipelineStage::AllCommands, PipelineAccess::MemoryRead);
+	}
+	for (ImageHandoff& handoff : acquirable_images) {
+		graphics_command_buffer.cmd_acquire_image(*handoff.image, transfer_family, handoff.old_layout, ImageState::for_layout(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+	}
+
+	acquirable_buffers.clear();
+	acquirable_images.clear();
+
+	uint64_t value = acquirable_value;
+	acquirable_value = 0;
+	if (graphics_queue) return std::nullopt;
+	return TimelineWait{ &queue, value, PipelineStage::AllCommands };
+}
+
+/**
+ * Called when a buffer is destroyed. Its queued upload is dropped, and it's forgotten by any batch releasing it so
+ * acquire() never records a barrier for it. Copies already submitted finish before the deletion queue frees it
+ */
+void UploadManager::cancel(const Buffer& buffer) {
+	std::erase_if(pending, [&buffer](const PendingUpload& upload) { return upload.destination_buffer == &buffer; });
+	for (Batch& batch : batches) {
+		std::erase(batch.released_buffers, &buffer);
+	}
+	std::erase(acquirable_buffers, &buffer);
+	graphics_owned_buffers.erase(&buffer);
+}
+
+void UploadManager::cancel(const Image& image) {
+	std::erase_if(pending, [&image](const PendingUpload& upload) { return upload.destination_image == &image; });
+	for (Batch& batch : batches) {
+		std::erase_if(batch.released_images, [&image](const ImageHandoff& handoff) { return handoff.image == &image; });
+	}
+	std::erase_if(acquirable_images, [&image](const ImageHandoff& handoff) { return handoff.image == &image; });
+}
+
+/**
+ * Resources still waiting to be acquired count as in flight, so nothing moves them before graphics owns them
+ */
+bool UploadManager::is_idle() const {
+	return pending.empty() && batches.empty() && acquirable_value == 0;
+}
+
+bool UploadManager::transfers_ownership() const {
+	return queue.queue_family.index != graphics_family;
+}
+
+/**
+ * Copies the data into the staging ring now, so the caller can free it straight away
+ */
+UploadManager::PendingUpload& UploadManager::stage(const void* data, VkDeviceSize data_size) {
+	PendingUpload upload{};
+	upload.ticket = next_ticket++;
+	upload.size = data_size;
+
+	if (data_size > staging_size) {
+		// Too big for the ring - give it its own staging buffer which lives until its batch finishes
+		upload.oversize_source = Buffer::create_empty_buffer(device, data_size, BufferUsage::TransferSource, MemoryProperties::HostVisible, LocalMemory::Dynamic, MemoryProperties::HostCached);
+		upload.oversize_source->fill_buffer(data, data_size);
+		upload.source = upload.oversize_source.get();
+		upload.source_offset = 0;
+		upload.staging_end = head;
+	} else {
+		std::optional<VkDeviceSize> offset = allocate_staging(data_size);
+		while (!offset.has_value()) {
+			// Out of room, so push everything queued and wait on the oldest batch to free its staging space
+			flush();
+			retire_batches(true);
+			offset = allocate_staging(data_size);
+		}
+
+		staging_buffer->fill_buffer(data, data_size, static_cast<uint32_t>(offset.value()));
+		upload.source = staging_buffer.get();
+		upload.source_offset = offset.value();
+		upload.staging_end = head;
+	}
+
+	pending.push_back(std::move(upload));
+	return pending.back();
+}
+
+/**
+ * Ring allocation between tail (oldest staging data still in use) and head (next free byte)
+ */
+std::optional<VkDeviceSize> UploadManager::allocate_staging(VkDeviceSize size) {
+	bool empty = pending.empty() && batches.empty();
+	if (empty) {
+		head = 0;
+		tail = 0;
+	}
+
+	VkDeviceSize offset = (head + staging_alignment - 1) / staging_alignment * staging_alignment;
+	if (head > tail || empty) {
+		if (offset + size <= staging_size) {
+			head = offset + size;
+			return offset;
+		}
+		// Wrap around to the start, leaving the end of the ring unused until the tail passes it
+		if (size <= tail) {
+			head = size;
+			return 0;
+		}
+	} else if (head < tail) {
+		if (offset + size <= tail) {
+			head = offset + size;
+			return offset;
+		}
+	}
+
+	return std::nullopt;
+}
+
+void UploadManager::submit_pending(VkDeviceSize byte_budget) {
+	if (pending.empty()) return;
+
+	// Everything staged so far goes out in one flush, rather than one per upload
+	staging_buffer->flush();
+
+	CommandBuffer* command_buffer;
+	if (!free_command_buffers.empty()) {
+		command_buffer = free_command_buffers.back();
+		free_command_buffers.pop_back();
+		command_buffer->reset();
+	} else {
+		command_buffer = &command_pool.create_command_buffer();
+	}
+
+
+	Batch batch{};
+	batch.command_buffer = command_buffer;
+
+	command_buffer->start_recording(true);
+
+	VkDeviceSize recorded_bytes = 0;
+	while (!pending.empty()) {
+		PendingUpload& upload = pending.front();
+		if (recorded_bytes > 0 && recorded_bytes + upload.size > byte_budget) break;
+
+		if (upload.destination_buffer != nullptr) {
+			command_buffer->cmd_copy_buffer(*upload.source, *upload.destination_buffer, upload.size, upload.source_offset, upload.destination_offset);
+			if (transfers_ownership()) {
+				command_buffer->cmd_release_buffer(*upload.destination_buffer, graphics_family, PipelineStage::TransferBit, PipelineAccess::TransferWrite);
+				batch.released_buffers.push_back(upload.destination_buffer);
+			}
+		} else {
+			command_buffer->cmd_transition_image(*upload.destination_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true);
+			command_buffer->cmd_copy_buffer_to_image(*upload.source, *upload.destination_image, upload.width, upload.height, upload.source_offset);
+			// Flushed together with the next image's barrier, rather than one call each
+			if (transfers_ownership()) {
+				command_buffer->cmd_release_image(*upload.destination_image, graphics_family, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				batch.released_images.push_back({ upload.destination_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL });
+			} else {
+				command_buffer->cmd_transition_image(*upload.destination_image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+			// The image now has a known layout, so the defragmenter can move it
+			upload.destination_image->enable_defragmentation();
+		}
+
+		recorded_bytes += upload.size;
+		batch.last_ticket = upload.ticket;
+		batch.staging_end = upload.staging_end;
+		if (upload.oversize_source) {
+			batch.oversize_sources.push_back(std::move(upload.oversize_source));
+		}
+		pending.pop_front();
+	}
+
+	command_buffer->stop_recording();
+
+	std::vector<std::pair<Semaphore*, VkPipelineStageFlags>> wait_semaphores;
+	std::vector<Semaphore*> signal_semaphores;
+	batch.timeline_value = queue.submit(*command_buffer, wait_semaphores, signal_semaphores);
+	batches.push_back(std::move(batch));
+}
+
+/**
+ * Batches finish in submission order, so stop at the first one which is still running
+ */
+void UploadManager::retire_batches(bool wait_for_oldest) {
+	if (wait_for_oldest && !batches.empty()) {
+		queue.wait(batches.front().timeline_value);
+	}
+
+	while (!batches.empty() && queue.is_complete(batches.front().timeline_value)) {
+		Batch& batch = batches.front();
+		completed_ticket = batch.last_ticket;
+		tail = batch.staging_end;
+		acquirable_value = batch.timeline_value;
+		acquirable_buffers.insert(acquirable_buffers.end(), batch.released_buffers.begin(), batch.released_buffers.end());
+		acquirable_images.insert(acquirable_images.end(), batch.released_images.begin(), batch.released_images.end());
+
+		free_command_buffers.push_back(batch.command_buffer);
+		batches.pop_front();
+	}
+}
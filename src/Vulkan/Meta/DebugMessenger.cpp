@@ -3,6 +3,7 @@
 #include <stdexcept>
 
 #include "Logger.h"
+#include "HostAllocator.h"
 
 DebugMessenger::DebugMessenger(Settings &settings) : settings(settings) {
     create_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
@@ -20,13 +21,13 @@ DebugMessenger::DebugMessenger(Settings &settings) : settings(settings) {
 
 DebugMessenger::~DebugMessenger() {
     Logger::log("Freeing Debug Messenger", Logger::VERBOSE);
-    if (instance.has_value()) vkDestroyDebugUtilsMessengerEXT(instance.value(), debug_messenger, nullptr);
+    if (instance.has_value()) vkDestroyDebugUtilsMessengerEXT(instance.value(), debug_messenger, HostAllocator::callbacks());
 }
 
 void DebugMessenger::create_messenger(VkInstance instance) {
     this->instance = instance;
 
-    if (vkCreateDebugUtilsMessengerEXT(instance, &create_info, nullptr, &debug_messenger) != VK_SUCCESS) {
+    if (vkCreateDebugUtilsMessengerEXT(instance, &create_info, HostAllocator::callbacks(), &debug_messenger) != VK_SUCCESS) {
         throw std::runtime_error("Could not setup the debug callbacks");
     }
 }
@@ -5,22 +5,49 @@
 #include "Helper.h"
 
 void AttachmentDescriptions::add_attachment(VkFormat format, bool store) {
+	add_attachment(format, store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE, false);
+}
+
+/**
+ * Adds an attachment whose contents only live for the render pass, such as depth or an intermediate colour
+ * target. It's cleared on load and never stored, so tile-based GPUs never touch memory for it.
+ * Back it with an Image created as transient
+ */
+void AttachmentDescriptions::add_transient_attachment(VkFormat format) {
+	add_attachment(format, VK_ATTACHMENT_STORE_OP_DONT_CARE, true);
+}
+
+void AttachmentDescriptions::add_attachment(VkFormat format, VkAttachmentStoreOp store_op, bool transient) {
+	VkImageLayout final_layout;
+	if (has_depth(format) || has_stencil(format)) {
+		final_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	}
+	else if (transient) {
+		// Never leaves the render pass, so there's no need to transition it for presenting
+		final_layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+	else {
+		final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	}
+
+	add_attachment(format, VK_ATTACHMENT_LOAD_OP_CLEAR, store_op, VK_IMAGE_LAYOUT_UNDEFINED, final_layout);
+}
+
+/**
+ * Adds an attachment with everything given explicitly, as worked out by a RenderGraph
+ */
+void AttachmentDescriptions::add_attachment(VkFormat format, VkAttachmentLoadOp load_op, VkAttachmentStoreOp store_op, VkImageLayout initial_layout, VkImageLayout final_layout) {
 	bool is_depth_stencil = has_depth(format) || has_stencil(format);
 
 	VkAttachmentDescription attachment_description{};
 	attachment_description.format = format;
 	attachment_description.samples = VK_SAMPLE_COUNT_1_BIT;
-	attachment_description.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachment_description.storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment_description.loadOp = load_op;
+	attachment_description.storeOp = store_op;
 	attachment_description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachment_description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachment_description.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	if (is_depth_stencil) {
-		attachment_description.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-	}
-	else {
-		attachment_description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-	}
+	attachment_description.initialLayout = initial_layout;
+	attachment_description.finalLayout = final_layout;
 
 	attachment_descriptions.push_back(attachment_description);
 
@@ -3,6 +3,8 @@
 #include <exception>
 
 #include "Helper.h"
+#include "HostAllocator.h"
+#include "AllocationTracker.h"
 
 DescriptorPool::DescriptorPool(Device &device, std::vector<DescriptorSetInfo>& descriptor_set_infos, uint32_t descriptor_count) : device(device), descriptor_set_infos(descriptor_set_infos), descriptor_count(descriptor_count) {
 	uint32_t max_descriptor_count = 0;
@@ -24,13 +26,13 @@ DescriptorPool::DescriptorPool(Device &device, std::vector<DescriptorSetInfo>& d
 	pool_info.pPoolSizes = pool_sizes.data();
 	pool_info.maxSets = max_descriptor_count;
 
-	if (vkCreateDescriptorPool(device.get(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+	if (vkCreateDescriptorPool(device.get(), &pool_info, HostAllocator::callbacks(), &descriptor_pool) != VK_SUCCESS) {
 		throw std::runtime_error("Unable to create descriptor pool");
 	}
 }
 
 DescriptorPool::~DescriptorPool() {
-	vkDestroyDescriptorPool(device.get(), descriptor_pool, nullptr);
+	vkDestroyDescriptorPool(device.get(), descriptor_pool, HostAllocator::callbacks());
 }
 
 VkDescriptorSet DescriptorPool::get_descriptor_set(uint32_t index) {
@@ -56,71 +58,111 @@ void DescriptorPool::allocate_descriptor_set(VkDescriptorSetLayout descriptor_se
 }
 
 void DescriptorPool::update_descriptor_sets(std::vector<DescriptorAccess>& data) {
+	AllocationSite site("DescriptorPool::update_descriptor_sets");
 	if (data.size() != descriptor_set_infos.size()) {
 		throw std::runtime_error("The number of buffers sets must match the number of descriptor sets");
 	}
 
+	descriptor_accesses = data;
+	written_generations.assign(descriptor_count, 0);
+	for (uint32_t i = 0; i < descriptor_count; i++) {
+		write_descriptor_set(i);
+	}
+}
+
+/**
+ * Points the descriptor sets at new resources, e.g. images recreated on resize. Sets may still be in use by the GPU,
+ * so each is only rewritten by its next refresh_descriptor_set
+ */
+void DescriptorPool::replace_descriptor_accesses(std::vector<DescriptorAccess>& data) {
+	if (data.size() != descriptor_set_infos.size()) {
+		throw std::runtime_error("The number of buffers sets must match the number of descriptor sets");
+	}
+
+	descriptor_accesses = data;
+	// No move generation ever matches, so every set is stale
+	written_generations.assign(descriptor_count, UINT64_MAX);
+}
+
+/**
+ * Rewrites the descriptor set if the defragmenter has moved resources since it was last written.
+ * The set must not be in use by the GPU, so call this after waiting on the frame using it
+ */
+void DescriptorPool::refresh_descriptor_set(uint32_t index) {
+	AllocationSite site("DescriptorPool::refresh_descriptor_set");
+	if (index >= written_generations.size()) {
+		throw std::runtime_error("Requested descriptor set beyond descriptor pool range");
+	}
+
+	if (written_generations[index] != device.get_allocator().get_move_generation()) {
+		write_descriptor_set(index);
+	}
+}
+
+void DescriptorPool::write_descriptor_set(uint32_t index) {
 	using DescriptorInfo = std::variant<VkDescriptorBufferInfo, VkDescriptorImageInfo>;
 
-	for (size_t i = 0; i < descriptor_count; i++) {
-		std::vector<VkWriteDescriptorSet> descriptor_writes{};
-		boost::ptr_vector<DescriptorInfo> descriptor_infos{};
-
-		for (uint32_t j = 0; j < descriptor_set_infos.size(); j++) {
-			auto& descriptor_set_access = data[j];
-			auto& descriptor_set_info = descriptor_set_infos[j];
-
-			VkWriteDescriptorSet descriptor_write{};
-			descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptor_write.dstSet = descriptor_sets[i];
-			descriptor_write.dstBinding = j;
-			descriptor_write.dstArrayElement = 0;
-			descriptor_write.descriptorCount = 1;
-			descriptor_write.descriptorType = get_access_type(descriptor_set_info.descriptor_type);
-
-			switch (descriptor_set_info.descriptor_type) {
-			case DescriptorType::Sampler:
-			{
-				if (!std::holds_alternative<boost::ptr_vector<Buffer> *>(descriptor_set_access)) {
-					throw std::runtime_error("DescriptorPool::update_descriptor_sets must be given a ptr_vector<Buffer> if DescriptorType::Sampler is used");
-				}
-				if (std::get<boost::ptr_vector<Buffer> *>(descriptor_set_access)->size() != descriptor_count) {
-					throw std::runtime_error("The number of buffers must match the descriptor pool size");
-				}
-
-				auto& descriptor_set_buffers = *std::get<boost::ptr_vector<Buffer> *>(descriptor_set_access);
-
-				VkDescriptorBufferInfo buffer_info{};
-				descriptor_infos.push_back(new DescriptorInfo{ buffer_info });
-				buffer_info.buffer = descriptor_set_buffers[i].get();
-				buffer_info.offset = 0;
-				buffer_info.range = descriptor_set_info.descriptor_size;
-				descriptor_write.pBufferInfo = &buffer_info;
-				break;
+	std::vector<VkWriteDescriptorSet> descriptor_writes{};
+	boost::ptr_vector<DescriptorInfo> descriptor_infos{};
+
+	for (uint32_t j = 0; j < descriptor_set_infos.size(); j++) {
+		auto& descriptor_set_access = descriptor_accesses[j];
+		auto& descriptor_set_info = descriptor_set_infos[j];
+
+		VkWriteDescriptorSet descriptor_write{};
+		descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_write.dstSet = descriptor_sets[index];
+		descriptor_write.dstBinding = j;
+		descriptor_write.dstArrayElement = 0;
+		descriptor_write.descriptorCount = 1;
+		descriptor_write.descriptorType = get_access_type(descriptor_set_info.descriptor_type);
+
+		switch (descriptor_set_info.descriptor_type) {
+		case DescriptorType::Sampler:
+		case DescriptorType::UniformBufferDynamic:
+		case DescriptorType::StorageBuffer:
+		{
+			if (!std::holds_alternative<boost::ptr_vector<Buffer> *>(descriptor_set_access)) {
+				throw std::runtime_error("DescriptorPool::update_descriptor_sets must be given a ptr_vector<Buffer> if a buffer descriptor is used");
 			}
-			case DescriptorType::CombinedImageSampler:
-			{
-				if (!std::holds_alternative<ImageSampler>(descriptor_set_access)) {
-					throw std::runtime_error("DescriptorPool::update_descriptor_sets must be given a ptr_vector<Buffer> if DescriptorType::Sampler is used");
-				}
-
-				auto& descriptor_set_sampler = std::get<ImageSampler>(descriptor_set_access);
-
-				VkDescriptorImageInfo image_info{};
-				descriptor_infos.push_back(new DescriptorInfo{ image_info });
-				image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				image_info.imageView = descriptor_set_sampler.image_view;
-				image_info.sampler = descriptor_set_sampler.sampler;
-				descriptor_write.pImageInfo = &image_info;
-				break;
+			if (std::get<boost::ptr_vector<Buffer> *>(descriptor_set_access)->size() != descriptor_count) {
+				throw std::runtime_error("The number of buffers must match the descriptor pool size");
 			}
-			default:
-				throw std::runtime_error("Unknown descriptor type");
+
+			auto& descriptor_set_buffers = *std::get<boost::ptr_vector<Buffer> *>(descriptor_set_access);
+
+			// For dynamic buffers the range is the size of one draw's data, the offset is given when binding
+			VkDescriptorBufferInfo buffer_info{};
+			buffer_info.buffer = descriptor_set_buffers[index].get();
+			buffer_info.offset = 0;
+			buffer_info.range = descriptor_set_info.descriptor_size;
+			descriptor_infos.push_back(new DescriptorInfo{ buffer_info });
+			descriptor_write.pBufferInfo = &std::get<VkDescriptorBufferInfo>(descriptor_infos.back());
+			break;
+		}
+		case DescriptorType::CombinedImageSampler:
+		{
+			if (!std::holds_alternative<ImageSampler>(descriptor_set_access)) {
+				throw std::runtime_error("DescriptorPool::update_descriptor_sets must be given an ImageSampler if DescriptorType::CombinedImageSampler is used");
 			}
 
-			descriptor_writes.push_back(descriptor_write);
+			auto& descriptor_set_sampler = std::get<ImageSampler>(descriptor_set_access);
+
+			VkDescriptorImageInfo image_info{};
+			image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			image_info.imageView = descriptor_set_sampler.image->get_view();
+			image_info.sampler = descriptor_set_sampler.sampler;
+			descriptor_infos.push_back(new DescriptorInfo{ image_info });
+			descriptor_write.pImageInfo = &std::get<VkDescriptorImageInfo>(descriptor_infos.back());
+			break;
+		}
+		default:
+			throw std::runtime_error("Unknown descriptor type");
 		}
 
-		vkUpdateDescriptorSets(device.get(), descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+		descriptor_writes.push_back(descriptor_write);
 	}
+
+	vkUpdateDescriptorSets(device.get(), descriptor_writes.size(), descriptor_writes.data(), 0, nullptr);
+	written_generations[index] = device.get_allocator().get_move_generation();
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "Pipeline.h"
 
 #include "Logger.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
 
 Pipeline::Pipeline(Device& device) :
 	device(device)
@@ -10,9 +12,11 @@ Pipeline::Pipeline(Device& device) :
 Pipeline::~Pipeline() {
 	if (!setup) return;
 	Logger::log("Freeing Pipeline", Logger::VERBOSE);
-	vkDestroyPipelineLayout(device.get(), pipeline_layout, nullptr);
-	vkDestroyPipeline(device.get(), pipeline, nullptr);
-	if (descriptor_set_layout.has_value()) vkDestroyDescriptorSetLayout(device.get(), descriptor_set_layout.value(), nullptr);
+	device.get_deletion_queue().push([vk_device = device.get(), pipeline_layout = pipeline_layout, pipeline = pipeline, descriptor_set_layout = descriptor_set_layout]() {
+		vkDestroyPipelineLayout(vk_device, pipeline_layout, HostAllocator::callbacks());
+		vkDestroyPipeline(vk_device, pipeline, HostAllocator::callbacks());
+		if (descriptor_set_layout.has_value()) vkDestroyDescriptorSetLayout(vk_device, descriptor_set_layout.value(), HostAllocator::callbacks());
+	});
 }
 
 void Pipeline::create(Shader& vertex_shader, Shader& fragment_shader, RenderPass &render_pass) {
@@ -36,23 +40,7 @@ void Pipeline::create(Shader& vertex_shader, Shader& fragment_shader, RenderPass
 
 	VkPipelineColorBlendStateCreateInfo color_blend_info = create_color_blend_state(color_blend_attachment_infos);
 
-	create_descriptor_set_layout();
-
-	VkPipelineLayoutCreateInfo pipeline_layout_info{};
-	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	if (descriptor_set_layout.has_value()) {
-		pipeline_layout_info.setLayoutCount = 1;
-		pipeline_layout_info.pSetLayouts = &descriptor_set_layout.value();
-	} else {
-		pipeline_layout_info.setLayoutCount = 0;
-		pipeline_layout_info.pSetLayouts = nullptr;
-	}
-	pipeline_layout_info.pushConstantRangeCount = 0;
-	pipeline_layout_info.pPushConstantRanges = nullptr;
-
-	if (vkCreatePipelineLayout(device.get(), &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS) {
-		throw std::runtime_error("Could not create pipeline layout");
-	}
+	create_pipeline_layout();
 
 	VkGraphicsPipelineCreateInfo pipeline_info{};
 	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -72,7 +60,7 @@ void Pipeline::create(Shader& vertex_shader, Shader& fragment_shader, RenderPass
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 	pipeline_info.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(device.get(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+	if (vkCreateGraphicsPipelines(device.get(), VK_NULL_HANDLE, 1, &pipeline_info, HostAllocator::callbacks(), &pipeline) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create pipeline");
 	}
 
@@ -118,6 +106,10 @@ VkDescriptorSetLayout Pipeline::get_descriptor_set_layout() {
 	return descriptor_set_layout.value();
 }
 
+VkPipelineBindPoint Pipeline::get_bind_point() const {
+	return bind_point;
+}
+
 VkPipelineShaderStageCreateInfo Pipeline::create_shader_stage(Shader& shader, ShaderType type) {
 	VkPipelineShaderStageCreateInfo shader_stage_info{};
 	shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -128,6 +120,9 @@ VkPipelineShaderStageCreateInfo Pipeline::create_shader_stage(Shader& shader, Sh
 	case FRAGMENT:
 		shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		break;
+	case COMPUTE_SHADER:
+		shader_stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		break;
 	default:
 		throw std::runtime_error("Unknown shader stage");
 	}
@@ -136,6 +131,29 @@ VkPipelineShaderStageCreateInfo Pipeline::create_shader_stage(Shader& shader, Sh
 	return shader_stage_info;
 }
 
+/**
+ * Creates the descriptor set layout from the bindings added so far, and the pipeline layout using it
+ */
+void Pipeline::create_pipeline_layout() {
+	create_descriptor_set_layout();
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	if (descriptor_set_layout.has_value()) {
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &descriptor_set_layout.value();
+	} else {
+		pipeline_layout_info.setLayoutCount = 0;
+		pipeline_layout_info.pSetLayouts = nullptr;
+	}
+	pipeline_layout_info.pushConstantRangeCount = 0;
+	pipeline_layout_info.pPushConstantRanges = nullptr;
+
+	if (vkCreatePipelineLayout(device.get(), &pipeline_layout_info, HostAllocator::callbacks(), &pipeline_layout) != VK_SUCCESS) {
+		throw std::runtime_error("Could not create pipeline layout");
+	}
+}
+
 VkPipelineDynamicStateCreateInfo Pipeline::create_dynamic_state(DynamicState& dynamic_state) {
 	VkPipelineDynamicStateCreateInfo dynamic_state_info{};
 	dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
@@ -258,7 +276,7 @@ void Pipeline::create_descriptor_set_layout() {
 	descriptor_set_layout_info.pBindings = descriptor_set_bindings.data();
 
 	VkDescriptorSetLayout descriptor_set_layout;
-	if (vkCreateDescriptorSetLayout(device.get(), &descriptor_set_layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+	if (vkCreateDescriptorSetLayout(device.get(), &descriptor_set_layout_info, HostAllocator::callbacks(), &descriptor_set_layout) != VK_SUCCESS) {
 		throw std::runtime_error("Unable to create descriptor set layout");
 	}
 
@@ -270,4 +288,25 @@ void Pipeline::enable_depth_test() {
 		throw std::runtime_error("Cannot enable depth test after setting up pipeline");
 	}
 	this->depth_test = true;
+}
+
+ComputePipeline::ComputePipeline(Device& device) : Pipeline(device) {
+	bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+}
+
+void ComputePipeline::create(Shader& compute_shader) {
+	create_pipeline_layout();
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage = create_shader_stage(compute_shader, COMPUTE_SHADER);
+	pipeline_info.layout = pipeline_layout;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_info.basePipelineIndex = -1;
+
+	if (vkCreateComputePipelines(device.get(), VK_NULL_HANDLE, 1, &pipeline_info, HostAllocator::callbacks(), &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+
+	setup = true;
 }
\ No newline at end of file
@@ -0,0 +1,737 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "CommandBuffer.h"
+#include "SubpassDependency.h"
+#include "ResourcePools.h"
+#include "DeletionQueue.h"
+#include "Logger.h"
+#include "Helper.h"
+#include "AllocationTracker.h"
+
+static constexpr VkAccessFlags write_access_mask = PipelineAccess::ShaderWrite | PipelineAccess::ColourAttachmentWrite |
+	PipelineAccess::DepthStencilAttachmentWrite | PipelineAccess::TransferWrite | PipelineAccess::HostWrite | PipelineAccess::MemoryWrite;
+
+static VkImageUsageFlags usage_for_layout(VkImageLayout layout) {
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+		return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+		return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		return VK_IMAGE_USAGE_SAMPLED_BIT;
+	case VK_IMAGE_LAYOUT_GENERAL:
+		return VK_IMAGE_USAGE_STORAGE_BIT;
+	default:
+		throw std::invalid_argument("No image usage for layout " + std::to_string(layout));
+	}
+}
+
+RenderGraph::Pass::Pass(const std::string& name, PassType type) : name(name), type(type) {}
+
+void RenderGraph::Pass::write_colour(GraphImage image) {
+	add_image_access(image, ImageState::for_layout(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL), true);
+}
+
+void RenderGraph::Pass::write_depth(GraphImage image) {
+	add_image_access(image, ImageState::for_layout(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL), true);
+}
+
+void RenderGraph::Pass::read_texture(GraphImage image, VkPipelineStageFlags stage) {
+	add_image_access(image, { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stage, PipelineAccess::ShaderRead }, false);
+}
+
+void RenderGraph::Pass::read_storage_image(GraphImage image, VkPipelineStageFlags stage) {
+	add_image_access(image, { VK_IMAGE_LAYOUT_GENERAL, stage, PipelineAccess::ShaderRead }, false);
+}
+
+void RenderGraph::Pass::write_storage_image(GraphImage image, VkPipelineStageFlags stage) {
+	add_image_access(image, { VK_IMAGE_LAYOUT_GENERAL, stage, PipelineAccess::ShaderWrite }, false);
+}
+
+void RenderGraph::Pass::read_buffer(GraphBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access) {
+	buffer_accesses.push_back({ buffer.index, stage, access & ~write_access_mask });
+}
+
+void RenderGraph::Pass::write_buffer(GraphBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access) {
+	if ((access & write_access_mask) == 0) {
+		throw std::invalid_argument("Pass " + name + " writes a buffer without any write access");
+	}
+	buffer_accesses.push_back({ buffer.index, stage, access });
+}
+
+void RenderGraph::Pass::set_record(std::function<void(CommandBuffer&)> record) {
+	this->record = std::move(record);
+}
+
+/**
+ * Begins the pass's render pass for secondary command buffers only, so its record function can spread its draws
+ * across threads with a ParallelRecorder
+ */
+void RenderGraph::Pass::use_secondary_command_buffers() {
+	if (type != PassType::GRAPHICS) {
+		throw std::invalid_argument("Only graphics passes have a render pass to record secondary command buffers into, which " + name + " isn't");
+	}
+	secondary_contents = true;
+}
+
+/**
+ * Keeps the pass even if nothing reads what it writes, for passes with side effects the graph can't see
+ */
+void RenderGraph::Pass::keep() {
+	kept = true;
+}
+
+bool RenderGraph::Pass::uses(uint32_t image) const {
+	return std::any_of(image_accesses.begin(), image_accesses.end(), [image](const ImageAccess& access) { return access.image == image; });
+}
+
+bool RenderGraph::Pass::uses_buffer(uint32_t buffer) const {
+	return std::any_of(buffer_accesses.begin(), buffer_accesses.end(), [buffer](const BufferAccess& access) { return access.buffer == buffer; });
+}
+
+bool RenderGraph::Pass::writes(uint32_t image) const {
+	return std::any_of(image_accesses.begin(), image_accesses.end(), [image](const ImageAccess& access) {
+		return access.image == image && !access.state.is_read_only();
+	});
+}
+
+bool RenderGraph::Pass::writes_buffer(uint32_t buffer) const {
+	return std::any_of(buffer_accesses.begin(), buffer_accesses.end(), [buffer](const BufferAccess& access) {
+		return access.buffer == buffer && (access.access & write_access_mask) != 0;
+	});
+}
+
+void RenderGraph::Pass::add_image_access(GraphImage image, const ImageState& state, bool attachment) {
+	// A subresource can only be in one layout for the whole pass
+	if (uses(image.index)) {
+		throw std::invalid_argument("Pass " + name + " uses an image more than once");
+	}
+	if (attachment && type != PassType::GRAPHICS) {
+		throw std::invalid_argument("Only graphics passes can write attachments, which " + name + " isn't");
+	}
+	image_accesses.push_back({ image.index, state, attachment });
+}
+
+RenderGraph::RenderGraph(Device& device) : device(device) {}
+
+RenderGraph::~RenderGraph() {
+	Logger::log("Freeing Render Graph", Logger::VERBOSE);
+	free_framebuffers();
+	free_images();
+}
+
+GraphImage RenderGraph::create_image(const std::string& name, const GraphImageDescription& description) {
+	if (compiled) throw std::runtime_error("Can't add images to a compiled render graph");
+
+	ImageResource resource{};
+	resource.name = name;
+	resource.format = description.format;
+	resource.description = description;
+	images.push_back(std::move(resource));
+	return { static_cast<uint32_t>(images.size() - 1) };
+}
+
+/**
+ * Adds an image which lives outside the graph, such as a swapchain image. incoming_state is the state it's in
+ * at the start of each frame - an UNDEFINED layout means its contents from earlier frames aren't needed.
+ * The image itself is given each frame with set_image
+ */
+GraphImage RenderGraph::import_image(const std::string& name, VkFormat format, const ImageState& incoming_state) {
+	if (compiled) throw std::runtime_error("Can't add images to a compiled render graph");
+
+	ImageResource resource{};
+	resource.name = name;
+	resource.format = format;
+	resource.incoming_state = incoming_state;
+	images.push_back(std::move(resource));
+	return { static_cast<uint32_t>(images.size() - 1) };
+}
+
+GraphBuffer RenderGraph::import_buffer(const std::string& name) {
+	if (compiled) throw std::runtime_error("Can't add buffers to a compiled render graph");
+
+	BufferResource resource{};
+	resource.name = name;
+	buffers.push_back(std::move(resource));
+	return { static_cast<uint32_t>(buffers.size() - 1) };
+}
+
+/**
+ * Sets the state an image is left in once the frame's last pass using it has finished, e.g. PRESENT_SRC_KHR
+ */
+void RenderGraph::set_output(GraphImage image, const ImageState& final_state) {
+	images.at(image.index).final_state = final_state;
+}
+
+RenderGraph::Pass& RenderGraph::add_pass(const std::string& name, PassType type) {
+	if (compiled) throw std::runtime_error("Can't add passes to a compiled render graph");
+
+	passes.push_back(std::unique_ptr<Pass>(new Pass(name, type)));
+	return *passes.back();
+}
+
+void RenderGraph::compile(VkExtent2D extent) {
+	this->extent = extent;
+	free_framebuffers();
+	free_images();
+
+	for (auto& pass : passes) {
+		pass->render_pass.reset();
+		pass->attachments.clear();
+		pass->final_states.clear();
+	}
+
+	cull();
+	sort();
+	find_lifetimes();
+	for (uint32_t position = 0; position < order.size(); position++) {
+		if (order[position]->type == PassType::GRAPHICS) {
+			build_render_pass(*order[position], position);
+		}
+	}
+	allocate_images();
+	compiled = true;
+
+	Logger::log("Compiled render graph with " + std::to_string(order.size()) + " of " + std::to_string(passes.size()) +
+		" passes, using " + std::to_string(get_image_memory()) + " bytes of aliased image memory", Logger::VERBOSE);
+}
+
+/**
+ * Recreates the graph's images and framebuffers for a new extent. The render passes don't depend on the extent,
+ * so pipelines built against them stay valid. Also call this when imported images are recreated, as cached
+ * framebuffers refer to their views
+ */
+void RenderGraph::resize(VkExtent2D extent) {
+	if (!compiled) {
+		compile(extent);
+		return;
+	}
+
+	this->extent = extent;
+	free_framebuffers();
+	free_images();
+	allocate_images();
+}
+
+void RenderGraph::set_image(GraphImage image, Image& target) {
+	ImageResource& resource = images.at(image.index);
+	if (resource.description.has_value()) {
+		throw std::invalid_argument("Image " + resource.name + " is owned by the render graph, so can't be set");
+	}
+	resource.image = &target;
+}
+
+void RenderGraph::set_buffer(GraphBuffer buffer, Buffer& target) {
+	buffers.at(buffer.index).buffer = &target;
+}
+
+/**
+ * Records every pass which survived culling, in order, with the barriers between them
+ */
+void RenderGraph::execute(CommandBuffer& command_buffer) {
+	AllocationSite site("RenderGraph::execute");
+	if (!compiled) throw std::runtime_error("Render graph must be compiled before it's executed");
+
+	for (ImageResource& resource : images) {
+		if (resource.description.has_value() || resource.first_use == UINT32_MAX) continue;
+
+		if (resource.image == nullptr) {
+			throw std::runtime_error("Imported image " + resource.name + " hasn't been set");
+		}
+		// Whatever happened to it before this frame doesn't matter, so there's nothing to wait for
+		if (resource.incoming_state.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+			resource.image->set_state(resource.incoming_state);
+		}
+	}
+
+	for (uint32_t position = 0; position < order.size(); position++) {
+		record_pass(command_buffer, *order[position], position);
+	}
+
+	// Render passes leave attachments in their output state themselves, everything else is moved here
+	for (ImageResource& resource : images) {
+		if (!resource.final_state.has_value() || resource.last_use == UINT32_MAX) continue;
+		if (resource.image->get_state().layout != resource.final_state->layout) {
+			command_buffer.cmd_transition_image(*resource.image, resource.final_state.value());
+		}
+	}
+}
+
+RenderPass& RenderGraph::get_render_pass(const Pass& pass) const {
+	if (!pass.render_pass) {
+		throw std::runtime_error("Pass " + pass.name + " has no render pass. Is the graph compiled and the pass a graphics pass?");
+	}
+	return *pass.render_pass;
+}
+
+/**
+ * The image backing a graph image, e.g. to sample it from a descriptor set. Images the graph owns are recreated
+ * on resize, so fetch it again afterwards
+ */
+Image& RenderGraph::get_image(GraphImage image) const {
+	const ImageResource& resource = images.at(image.index);
+	if (resource.image == nullptr) {
+		throw std::runtime_error("Image " + resource.name + " has no image. Is the graph compiled and the image used?");
+	}
+	return *resource.image;
+}
+
+/**
+ * Whether both images were given the same memory slot, so are never in use at the same time
+ */
+bool RenderGraph::shares_memory(GraphImage first, GraphImage second) const {
+	return std::any_of(memory_slots.begin(), memory_slots.end(), [&](const MemorySlot& slot) {
+		return std::find(slot.images.begin(), slot.images.end(), first.index) != slot.images.end()
+			&& std::find(slot.images.begin(), slot.images.end(), second.index) != slot.images.end();
+	});
+}
+
+VkExtent2D RenderGraph::get_extent() const {
+	return extent;
+}
+
+VkDeviceSize RenderGraph::get_image_memory() const {
+	VkDeviceSize total = 0;
+	for (const MemorySlot& slot : memory_slots) {
+		total += slot.allocation.size;
+	}
+	return total;
+}
+
+bool RenderGraph::is_culled(const Pass& pass) const {
+	return pass.culled;
+}
+
+bool RenderGraph::is_imported(uint32_t image) const {
+	return !images[image].description.has_value();
+}
+
+/**
+ * Passes which access the same resource, where at least one of them writes it, have to run in declaration order
+ */
+bool RenderGraph::conflicts(const Pass& first, const Pass& second) {
+	for (const Pass::ImageAccess& access : first.image_accesses) {
+		if (!second.uses(access.image)) continue;
+		if (!access.state.is_read_only() || second.writes(access.image)) return true;
+	}
+	for (const Pass::BufferAccess& access : first.buffer_accesses) {
+		if (!second.uses_buffer(access.buffer)) continue;
+		if ((access.access & write_access_mask) != 0 || second.writes_buffer(access.buffer)) return true;
+	}
+	return false;
+}
+
+/**
+ * Walks back from the passes whose results leave the frame - kept passes and writers of imported resources -
+ * marking every earlier pass which writes something they use. Anything left unmarked is culled
+ */
+void RenderGraph::cull() {
+	std::vector<uint32_t> needed;
+	for (uint32_t i = 0; i < passes.size(); i++) {
+		Pass& pass = *passes[i];
+		// Every buffer is imported
+		bool writes_imported = pass.kept;
+		for (const Pass::ImageAccess& access : pass.image_accesses) {
+			if (is_imported(access.image) && !access.state.is_read_only()) writes_imported = true;
+		}
+		for (const Pass::BufferAccess& access : pass.buffer_accesses) {
+			if ((access.access & write_access_mask) != 0) writes_imported = true;
+		}
+
+		pass.culled = !writes_imported;
+		if (writes_imported) needed.push_back(i);
+	}
+
+	while (!needed.empty()) {
+		Pass& pass = *passes[needed.back()];
+		uint32_t index = needed.back();
+		needed.pop_back();
+
+		for (uint32_t i = 0; i < index; i++) {
+			Pass& earlier = *passes[i];
+			if (!earlier.culled) continue;
+
+			bool produces = false;
+			for (const Pass::ImageAccess& access : pass.image_accesses) {
+				if (earlier.writes(access.image)) produces = true;
+			}
+			for (const Pass::BufferAccess& access : pass.buffer_accesses) {
+				if (earlier.writes_buffer(access.buffer)) produces = true;
+			}
+
+			if (produces) {
+				earlier.culled = false;
+				needed.push_back(i);
+			}
+		}
+	}
+
+	for (auto& pass : passes) {
+		if (pass->culled) Logger::log("Culling render graph pass " + pass->name, Logger::VERBOSE);
+	}
+}
+
+/**
+ * Orders the passes so each runs after the passes it conflicts with. Of the passes which are ready, the one whose
+ * dependencies finished longest ago goes first, giving the GPU more independent work between a write and its read
+ */
+void RenderGraph::sort() {
+	std::vector<uint32_t> live;
+	for (uint32_t i = 0; i < passes.size(); i++) {
+		if (!passes[i]->culled) live.push_back(i);
+	}
+
+	std::vector<std::vector<uint32_t>> successors(live.size());
+	std::vector<uint32_t> predecessor_count(live.size(), 0);
+	for (uint32_t first = 0; first < live.size(); first++) {
+		for (uint32_t second = first + 1; second < live.size(); second++) {
+			if (conflicts(*passes[live[first]], *passes[live[second]])) {
+				successors[first].push_back(second);
+				predecessor_count[second]++;
+			}
+		}
+	}
+
+	// One past the position of each pass's latest scheduled dependency
+	std::vector<uint32_t> ready_after(live.size(), 0);
+	std::vector<bool> scheduled(live.size(), false);
+	order.clear();
+	for (uint32_t position = 0; position < live.size(); position++) {
+		std::optional<uint32_t> next;
+		for (uint32_t i = 0; i < live.size(); i++) {
+			if (scheduled[i] || predecessor_count[i] != 0) continue;
+			if (!next.has_value() || ready_after[i] < ready_after[next.value()]) next = i;
+		}
+
+		scheduled[next.value()] = true;
+		order.push_back(passes[live[next.value()]].get());
+		for (uint32_t successor : successors[next.value()]) {
+			predecessor_count[successor]--;
+			ready_after[successor] = position + 1;
+		}
+	}
+}
+
+void RenderGraph::find_lifetimes() {
+	for (ImageResource& resource : images) {
+		resource.usage = 0;
+		resource.first_use = UINT32_MAX;
+		resource.last_use = UINT32_MAX;
+	}
+
+	for (uint32_t position = 0; position < order.size(); position++) {
+		for (const Pass::ImageAccess& access : order[position]->image_accesses) {
+			ImageResource& resource = images[access.image];
+			if (resource.first_use == UINT32_MAX) resource.first_use = position;
+			resource.last_use = position;
+			resource.usage |= usage_for_layout(access.state.layout);
+		}
+	}
+}
+
+/**
+ * Works out each attachment's load and store ops and layouts from the passes around this one, and a dependency
+ * on whatever last touched the attachments
+ */
+void RenderGraph::build_render_pass(Pass& pass, uint32_t position) {
+	pass.attachment_descriptions = {};
+	pass.attachments.clear();
+	pass.final_states.clear();
+
+	// Colour attachments come first, to match the attachment references
+	for (const Pass::ImageAccess& access : pass.image_accesses) {
+		if (access.attachment && access.state.layout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) pass.attachments.push_back(access);
+	}
+	for (const Pass::ImageAccess& access : pass.image_accesses) {
+		if (access.attachment && access.state.layout != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL) pass.attachments.push_back(access);
+	}
+	if (pass.attachments.empty()) {
+		throw std::runtime_error("Graphics pass " + pass.name + " has no attachments");
+	}
+
+	SubpassDependency dependency;
+	dependency.set_src_subpass(VK_SUBPASS_EXTERNAL);
+	dependency.set_dest_subpass(0);
+	VkPipelineStageFlags src_stages = 0;
+
+	for (const Pass::ImageAccess& access : pass.attachments) {
+		ImageResource& resource = images[access.image];
+		std::optional<ImageState> previous = find_previous_state(access.image, position);
+
+		VkAttachmentLoadOp load_op;
+		VkImageLayout initial_layout;
+		ImageState source;
+		if (previous.has_value()) {
+			load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+			initial_layout = previous->layout;
+			source = previous.value();
+		}
+		else if (!is_imported(access.image)) {
+			// Cleared every frame, but last frame's final use may still be running
+			load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+			source = find_previous_state(access.image, static_cast<uint32_t>(order.size())).value();
+		}
+		else {
+			initial_layout = resource.incoming_state.layout;
+			load_op = initial_layout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+			source = resource.incoming_state;
+		}
+
+		bool keep_contents = is_imported(access.image) || resource.last_use > position;
+		VkAttachmentStoreOp store_op = keep_contents ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		ImageState final_state = access.state;
+		if (resource.final_state.has_value() && resource.last_use == position) {
+			final_state = resource.final_state.value();
+		}
+
+		pass.attachment_descriptions.add_attachment(resource.format, load_op, store_op, initial_layout, final_state.layout);
+		pass.final_states.push_back(final_state);
+
+		src_stages |= source.stage;
+		// Reads don't need making available, only waiting on
+		dependency.add_src_access(source.access & write_access_mask);
+		dependency.add_dest_stage(access.state.stage);
+		dependency.add_dest_access(access.state.access);
+	}
+	dependency.add_src_stage(src_stages != 0 ? src_stages : PipelineStage::TopOfPipe);
+
+	pass.render_pass = std::make_unique<RenderPass>(device, pass.attachment_descriptions, std::vector{ dependency });
+}
+
+/**
+ * Images used by a single pass purely as attachments never hold anything between passes, so they get lazily
+ * allocated memory of their own where the device has it. The rest are packed into shared memory slots, biggest
+ * first, so images whose lifetimes within the frame don't overlap reuse the same memory
+ */
+void RenderGraph::allocate_images() {
+	MemoryAllocator& allocator = device.get_allocator();
+	constexpr VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+	std::vector<std::pair<uint32_t, VkMemoryRequirements>> aliasable;
+	for (uint32_t i = 0; i < images.size(); i++) {
+		ImageResource& resource = images[i];
+		if (is_imported(i) || resource.first_use == UINT32_MAX) continue;
+
+		const GraphImageDescription& description = resource.description.value();
+		uint32_t width = description.width != 0 ? description.width : extent.width;
+		uint32_t height = description.height != 0 ? description.height : extent.height;
+
+		if ((resource.usage & ~attachment_usage) == 0 && resource.first_use == resource.last_use) {
+			resource.owned = std::make_unique<Image>(device, resource.format, width, height, description.image_type, true);
+		}
+		else {
+			resource.owned = std::make_unique<Image>(device, resource.format, width, height, description.image_type, resource.usage);
+			aliasable.emplace_back(i, resource.owned->get_memory_requirements());
+		}
+		resource.image = resource.owned.get();
+	}
+
+	std::sort(aliasable.begin(), aliasable.end(), [](const auto& first, const auto& second) {
+		return first.second.size > second.second.size;
+	});
+
+	for (auto& [image, requirements] : aliasable) {
+		const ImageResource& resource = images[image];
+
+		MemorySlot* chosen = nullptr;
+		for (MemorySlot& slot : memory_slots) {
+			if ((slot.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0) continue;
+
+			bool overlaps = std::any_of(slot.images.begin(), slot.images.end(), [&](uint32_t other) {
+				return images[other].first_use <= resource.last_use && resource.first_use <= images[other].last_use;
+			});
+			if (!overlaps) {
+				chosen = &slot;
+				break;
+			}
+		}
+
+		if (chosen == nullptr) {
+			memory_slots.push_back({ requirements, { image }, {} });
+			continue;
+		}
+		chosen->requirements.size = std::max(chosen->requirements.size, requirements.size);
+		chosen->requirements.alignment = std::max(chosen->requirements.alignment, requirements.alignment);
+		chosen->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+		chosen->images.push_back(image);
+	}
+
+	for (MemorySlot& slot : memory_slots) {
+		bool depth = std::all_of(slot.images.begin(), slot.images.end(), [this](uint32_t image) {
+			return images[image].description->image_type != ImageType::COLOUR;
+		});
+		MemoryCategory category = depth ? MemoryCategory::DEPTH : MemoryCategory::TEXTURE;
+		slot.allocation = allocator.allocate(slot.requirements, MemoryProperties::DeviceLocal, AllocationTiling::OPTIMAL, category);
+
+		std::sort(slot.images.begin(), slot.images.end(), [this](uint32_t first, uint32_t second) {
+			return images[first].first_use < images[second].first_use;
+		});
+		for (uint32_t i = 0; i < slot.images.size(); i++) {
+			ImageResource& resource = images[slot.images[i]];
+			resource.owned->bind_memory(slot.allocation);
+			// The last image in the slot wrote to the memory last frame, before the first one reuses it
+			if (slot.images.size() > 1) {
+				resource.alias_predecessor = slot.images[(i + slot.images.size() - 1) % slot.images.size()];
+				Logger::log("Image " + resource.name + " reuses the memory of " + images[resource.alias_predecessor.value()].name, Logger::VERBOSE);
+			}
+		}
+	}
+}
+
+void RenderGraph::free_images() {
+	for (ImageResource& resource : images) {
+		if (!resource.owned) continue;
+
+		resource.owned.reset();
+		resource.image = nullptr;
+		resource.alias_predecessor.reset();
+	}
+
+	// Pushed after the images, so it's freed once they've been destroyed
+	for (MemorySlot& slot : memory_slots) {
+		device.get_deletion_queue().push([allocator = &device.get_allocator(), allocation = slot.allocation]() mutable {
+			allocator->free(allocation);
+		});
+	}
+	memory_slots.clear();
+}
+
+void RenderGraph::free_framebuffers() {
+	for (auto& pass : passes) {
+		for (Pass::CachedFramebuffer& cached : pass->framebuffers) {
+			device.get_resources().framebuffers.destroy(cached.framebuffer);
+		}
+		pass->framebuffers.clear();
+	}
+}
+
+/**
+ * The state image is left in by the last pass before position to use it, if any
+ */
+std::optional<ImageState> RenderGraph::find_previous_state(uint32_t image, uint32_t position) const {
+	const ImageResource& resource = images[image];
+	for (uint32_t i = position; i > 0; i--) {
+		for (const Pass::ImageAccess& access : order[i - 1]->image_accesses) {
+			if (access.image != image) continue;
+
+			if (resource.final_state.has_value() && resource.last_use == i - 1) return resource.final_state;
+			return access.state;
+		}
+	}
+	return std::nullopt;
+}
+
+/**
+ * Framebuffers are cached by the views they're made from, so one is kept for each swapchain image. View handles
+ * can be reused once destroyed, so the cache is dropped whenever the allocator has moved anything
+ */
+Framebuffer& RenderGraph::get_framebuffer(Pass& pass) {
+	ResourcePool<Framebuffer>& framebuffers = device.get_resources().framebuffers;
+
+	uint64_t move_generation = device.get_allocator().get_move_generation();
+	if (framebuffer_generation != move_generation) {
+		free_framebuffers();
+		framebuffer_generation = move_generation;
+	}
+
+	views.clear();
+	attachment_images.clear();
+	for (const Pass::ImageAccess& access : pass.attachments) {
+		Image* image = images[access.image].image;
+		views.push_back(image->get_view());
+		attachment_images.push_back(image);
+	}
+
+	for (const Pass::CachedFramebuffer& cached : pass.framebuffers) {
+		if (cached.views == views) return framebuffers.get(cached.framebuffer);
+	}
+
+	if (pass.framebuffers.size() >= max_cached_framebuffers) {
+		framebuffers.destroy(pass.framebuffers.front().framebuffer);
+		pass.framebuffers.erase(pass.framebuffers.begin());
+	}
+
+	Handle<Framebuffer> framebuffer = framebuffers.create(device, *pass.render_pass, attachment_images, extent);
+	pass.framebuffers.push_back({ views, framebuffer });
+	return framebuffers.get(framebuffer);
+}
+
+void RenderGraph::record_barriers(CommandBuffer& command_buffer, Pass& pass, uint32_t position) {
+	for (const Pass::ImageAccess& access : pass.image_accesses) {
+		ImageResource& resource = images[access.image];
+		bool first_use = resource.first_use == position;
+
+		if (first_use && resource.alias_predecessor.has_value()) {
+			// The memory was last used through another image, which has to finish with it first
+			const ImageState& previous = images[resource.alias_predecessor.value()].image->get_state();
+			VkPipelineStageFlags src_stage = previous.stage != 0 ? previous.stage : PipelineStage::TopOfPipe;
+			command_buffer.cmd_memory_barrier(src_stage, access.state.stage, previous.access & write_access_mask, access.state.access);
+		}
+
+		// The render pass moves attachments into place itself
+		if (!access.attachment) {
+			command_buffer.cmd_transition_image(*resource.image, access.state, first_use && !is_imported(access.image));
+		}
+	}
+
+	for (uint32_t i = 0; i < pass.attachments.size(); i++) {
+		const Pass::ImageAccess& access = pass.attachments[i];
+		Image& image = *images[access.image].image;
+		VkImageLayout initial_layout = pass.attachment_descriptions.attachment_descriptions[i].initialLayout;
+
+		// Imported images may not arrive in the layout the render pass was built for
+		if (initial_layout != VK_IMAGE_LAYOUT_UNDEFINED && image.get_state().layout != initial_layout) {
+			command_buffer.cmd_transition_image(image, { initial_layout, access.state.stage, access.state.access });
+		}
+	}
+
+	for (const Pass::BufferAccess& access : pass.buffer_accesses) {
+		BufferResource& resource = buffers[access.buffer];
+		if (resource.buffer == nullptr) {
+			throw std::runtime_error("Imported buffer " + resource.name + " hasn't been set");
+		}
+
+		if ((access.access & write_access_mask) != 0) {
+			VkPipelineStageFlags src_stages = resource.read_stages | resource.write_stage;
+			if (src_stages != 0) {
+				command_buffer.cmd_buffer_barrier(*resource.buffer, src_stages, access.stage, resource.write_access, access.access);
+			}
+			resource.write_stage = access.stage;
+			resource.write_access = access.access & write_access_mask;
+			resource.read_stages = 0;
+			resource.read_access = 0;
+		}
+		else {
+			bool visible = (resource.read_stages & access.stage) == access.stage && (resource.read_access & access.access) == access.access;
+			if (resource.write_stage != 0 && !visible) {
+				command_buffer.cmd_buffer_barrier(*resource.buffer, resource.write_stage, access.stage, resource.write_access, access.access);
+			}
+			resource.read_stages |= access.stage;
+			resource.read_access |= access.access;
+		}
+	}
+}
+
+void RenderGraph::record_pass(CommandBuffer& command_buffer, Pass& pass, uint32_t position) {
+	record_barriers(command_buffer, pass, position);
+
+	if (pass.type != PassType::GRAPHICS) {
+		command_buffer.cmd_flush_barriers();
+		if (pass.record) pass.record(command_buffer);
+		return;
+	}
+
+	VkSubpassContents contents = pass.secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+	command_buffer.cmd_begin_render_pass(*pass.render_pass, get_framebuffer(pass), pass.attachment_descriptions, contents);
+	if (pass.record) pass.record(command_buffer);
+	command_buffer.cmd_end_render_pass();
+
+	for (uint32_t i = 0; i < pass.attachments.size(); i++) {
+		images[pass.attachments[i].image].image->set_state(pass.final_states[i]);
+	}
+}
@@ -1,5 +1,6 @@
 #include "RenderPass.h"
 #include "Logger.h"
+#include "HostAllocator.h"
 
 RenderPass::RenderPass(Device &device, AttachmentDescriptions attachment_descriptions, std::vector<SubpassDependency> dependencies) :
     device(device)
@@ -26,14 +27,14 @@ RenderPass::RenderPass(Device &device, AttachmentDescriptions attachment_descrip
     render_pass_info.dependencyCount = vk_dependencies.size();
     render_pass_info.pDependencies = vk_dependencies.data();
 
-    if (vkCreateRenderPass(device.get(), &render_pass_info, nullptr, &render_pass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(device.get(), &render_pass_info, HostAllocator::callbacks(), &render_pass) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create render pass");
     }
 }
 
 RenderPass::~RenderPass() {
     Logger::log("Freeing Render Pass", Logger::VERBOSE);
-    vkDestroyRenderPass(device.get(), render_pass, nullptr);
+    vkDestroyRenderPass(device.get(), render_pass, HostAllocator::callbacks());
 }
 
 VkRenderPass RenderPass::get() {
@@ -6,6 +6,7 @@
 #include "Helper.h"
 #include "Logger.h"
 #include "Constants.h"
+#include "HostAllocator.h"
 
 Shader::Shader(Device &device, std::string filename) :
 	device(device)
@@ -17,14 +18,14 @@ Shader::Shader(Device &device, std::string filename) :
 	create_info.codeSize = shader_code.size();
 	create_info.pCode = reinterpret_cast<const uint32_t*>(shader_code.data());
 
-	if (vkCreateShaderModule(device.get(), &create_info, nullptr, &shader_module) != VK_SUCCESS) {
+	if (vkCreateShaderModule(device.get(), &create_info, HostAllocator::callbacks(), &shader_module) != VK_SUCCESS) {
 		throw std::runtime_error("Could not create shader module");
 	}
 }
 
 Shader::~Shader() {
 	Logger::log("Freeing Shader", Logger::VERBOSE);
-	vkDestroyShaderModule(device.get(), shader_module, nullptr);
+	vkDestroyShaderModule(device.get(), shader_module, HostAllocator::callbacks());
 }
 
 VkShaderModule Shader::get() {
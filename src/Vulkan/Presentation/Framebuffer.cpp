@@ -1,9 +1,16 @@
 #include "Framebuffer.h"
 
 #include "Logger.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
 
 Framebuffer::Framebuffer(Device &device, RenderPass &render_pass, std::vector<Image*> attachments, SwapChain &swap_chain) :
-	device(device), extent(swap_chain.get_extent())
+	Framebuffer(device, render_pass, attachments, swap_chain.get_extent())
+{
+}
+
+Framebuffer::Framebuffer(Device &device, RenderPass &render_pass, std::vector<Image*> attachments, VkExtent2D extent) :
+	device(device), extent(extent)
 {
     std::vector<VkImageView> views{};
     for (auto &attachment : attachments) {
@@ -15,18 +22,20 @@ Framebuffer::Framebuffer(Device &device, RenderPass &render_pass, std::vector<Im
     framebuffer_info.renderPass = render_pass.get();
     framebuffer_info.attachmentCount = views.size();
     framebuffer_info.pAttachments = views.data();
-    framebuffer_info.width = swap_chain.get_extent().width;
-    framebuffer_info.height = swap_chain.get_extent().height;
+    framebuffer_info.width = extent.width;
+    framebuffer_info.height = extent.height;
     framebuffer_info.layers = 1;
 
-    if (vkCreateFramebuffer(device.get(), &framebuffer_info, nullptr, &framebuffer) != VK_SUCCESS) {
+    if (vkCreateFramebuffer(device.get(), &framebuffer_info, HostAllocator::callbacks(), &framebuffer) != VK_SUCCESS) {
         throw std::runtime_error("Unable to create framebuffer");
     }
 }
 
 Framebuffer::~Framebuffer() {
     Logger::log("Freeing Framebuffer", Logger::VERBOSE);
-	vkDestroyFramebuffer(device.get(), framebuffer, nullptr);
+	device.get_deletion_queue().push([vk_device = device.get(), framebuffer = framebuffer]() {
+		vkDestroyFramebuffer(vk_device, framebuffer, HostAllocator::callbacks());
+	});
 }
 
 VkFramebuffer Framebuffer::get() {
@@ -3,16 +3,17 @@
 #include <stdexcept>
 
 #include "Logger.h"
+#include "HostAllocator.h"
 
 Surface::Surface(const Instance &instance, const Window &window) : instance(instance.get()) {
-    if (glfwCreateWindowSurface(instance.get(), window.get(), nullptr, &surface) != VK_SUCCESS) {
+    if (glfwCreateWindowSurface(instance.get(), window.get(), HostAllocator::callbacks(), &surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface");
     }
 }
 
 Surface::~Surface() {
     Logger::log("Freeing Surface", Logger::VERBOSE);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    vkDestroySurfaceKHR(instance, surface, HostAllocator::callbacks());
 }
 
 VkSurfaceKHR Surface::get() {
@@ -3,6 +3,10 @@
 #include <algorithm>
 
 #include "Logger.h"
+#include "ResourcePools.h"
+#include "HostAllocator.h"
+#include "DeletionQueue.h"
+#include "AllocationTracker.h"
 
 VkSurfaceFormatKHR SwapChain::default_surface_format(const std::vector<VkSurfaceFormatKHR>& formats) {
     std::map<VkFormat, uint32_t> format_priority;
@@ -56,7 +60,7 @@ VkExtent2D SwapChain::default_extent(const VkSurfaceCapabilitiesKHR& capabilitie
     }
 }
 
-SwapChain::SwapChain(Device &device, Window& window, Surface& surface, Settings& settings) :
+SwapChain::SwapChain(Device &device, Window& window, Surface& surface, Settings& settings, SwapChain* old_swap_chain) :
     device(device) 
 {
     PhysicalDevice& physical_device = device.physical_device;
@@ -103,9 +107,10 @@ SwapChain::SwapChain(Device &device, Window& window, Surface& surface, Settings&
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     create_info.presentMode = present_mode;
     create_info.clipped = VK_TRUE;
-    create_info.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver reuse the old swapchain's resources, and any frames still presenting from it carry on
+    create_info.oldSwapchain = old_swap_chain != nullptr ? old_swap_chain->get() : VK_NULL_HANDLE;
 
-    if (vkCreateSwapchainKHR(device.get(), &create_info, nullptr, &swap_chain) != VK_SUCCESS) {
+    if (vkCreateSwapchainKHR(device.get(), &create_info, HostAllocator::callbacks(), &swap_chain) != VK_SUCCESS) {
         throw std::runtime_error("Unable to create swapchain");
     }
 
@@ -115,14 +120,19 @@ SwapChain::SwapChain(Device &device, Window& window, Surface& surface, Settings&
     vkGetSwapchainImagesKHR(device.get(), swap_chain, &image_count, vk_images.data());
 
     for (auto vk_image : vk_images) {
-        Image *image = new Image(device, vk_image, image_format);
-        images.push_back(image);
+        images.push_back(device.get_resources().images.create(device, vk_image, image_format));
     }
 }
 
 SwapChain::~SwapChain() {
     Logger::log("Freeing Swapchain", Logger::VERBOSE);
-    vkDestroySwapchainKHR(device.get(), swap_chain, nullptr);
+    for (auto image : images) {
+        device.get_resources().images.destroy(image);
+    }
+    // Frames in flight may still be presenting from it
+    device.get_deletion_queue().push([vk_device = device.get(), swap_chain = swap_chain]() {
+        vkDestroySwapchainKHR(vk_device, swap_chain, HostAllocator::callbacks());
+    });
 }
 
 VkSwapchainKHR SwapChain::get() {
@@ -142,6 +152,7 @@ ImageIndex SwapChain::get_next_image(Fence& fence) {
 }
 
 ImageIndex SwapChain::get_next_image(VkSemaphore semaphore, VkFence fence) {
+    AllocationSite site("SwapChain::get_next_image");
     ImageIndex index;
     VkResult result = vkAcquireNextImageKHR(device.get(), swap_chain, UINT64_MAX, semaphore, fence, &index);
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
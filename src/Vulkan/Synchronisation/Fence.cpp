@@ -3,20 +3,21 @@
 #include <vulkan/vulkan.h>
 
 #include "Logger.h"
+#include "HostAllocator.h"
 
-Fence::Fence(Device& device) : device(device) {
+Fence::Fence(Device& device, bool signalled) : device(device) {
 	VkFenceCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	create_info.flags = signalled ? VK_FENCE_CREATE_SIGNALED_BIT : 0;
 
-	if (vkCreateFence(device.get(), &create_info, nullptr, &fence) != VK_SUCCESS) {
+	if (vkCreateFence(device.get(), &create_info, HostAllocator::callbacks(), &fence) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create fence");
 	}
 }
 
 Fence::~Fence() {
 	Logger::log("Freeing Fence", Logger::VERBOSE);
-	vkDestroyFence(device.get(), fence, nullptr);
+	vkDestroyFence(device.get(), fence, HostAllocator::callbacks());
 }
 
 VkFence Fence::get() {
@@ -31,6 +32,10 @@ void Fence::reset() {
 	vkResetFences(device.get(), 1, &fence);
 }
 
+bool Fence::is_signalled() {
+	return vkGetFenceStatus(device.get(), fence) == VK_SUCCESS;
+}
+
 void Fence::wait_all(std::vector<Fence>& fences, uint64_t timeout) {
 	wait_internal(fences, timeout, VK_TRUE);
 }
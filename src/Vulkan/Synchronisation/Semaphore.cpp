@@ -3,19 +3,20 @@
 #include <vulkan/vulkan.h>
 
 #include "Logger.h"
+#include "HostAllocator.h"
 
 Semaphore::Semaphore(Device &device) : device(device) {
 	VkSemaphoreCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	if (vkCreateSemaphore(device.get(), &create_info, nullptr, &semaphore) != VK_SUCCESS) {
+	if (vkCreateSemaphore(device.get(), &create_info, HostAllocator::callbacks(), &semaphore) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create semaphore");
 	}
 }
 
 Semaphore::~Semaphore() {
 	Logger::log("Freeing Semaphore", Logger::VERBOSE);
-	vkDestroySemaphore(device.get(), semaphore, nullptr);
+	vkDestroySemaphore(device.get(), semaphore, HostAllocator::callbacks());
 }
 
 VkSemaphore Semaphore::get() {
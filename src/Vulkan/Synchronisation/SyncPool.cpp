@@ -0,0 +1,16 @@
+#include "SyncPool.h"
+
+#include <string>
+
+#include "Logger.h"
+
+SyncPool::SyncPool(Device& device) : device(device) {}
+
+SyncPool::~SyncPool() {
+	Logger::log("Freeing Sync Pool of " + std::to_string(semaphores.size()) + " semaphores", Logger::VERBOSE);
+}
+
+Semaphore& SyncPool::acquire_semaphore() {
+	semaphores.push_back(std::make_unique<Semaphore>(device));
+	return *semaphores.back();
+}
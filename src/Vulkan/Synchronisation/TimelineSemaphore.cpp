@@ -0,0 +1,87 @@
+#include "TimelineSemaphore.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+
+#include "Logger.h"
+#include "HostAllocator.h"
+
+TimelineSemaphore::TimelineSemaphore(Device& device, uint64_t initial_value) : device(device), completed_value(initial_value) {
+	VkSemaphoreTypeCreateInfo type_info{};
+	type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	type_info.initialValue = initial_value;
+
+	VkSemaphoreCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	create_info.pNext = &type_info;
+
+	if (vkCreateSemaphore(device.get(), &create_info, HostAllocator::callbacks(), &semaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timeline semaphore");
+	}
+}
+
+TimelineSemaphore::~TimelineSemaphore() {
+	Logger::log("Freeing Timeline Semaphore", Logger::VERBOSE);
+	vkDestroySemaphore(device.get(), semaphore, HostAllocator::callbacks());
+}
+
+VkSemaphore TimelineSemaphore::get() {
+	return semaphore;
+}
+
+uint64_t TimelineSemaphore::get_value() {
+	uint64_t value;
+	if (vkGetSemaphoreCounterValue(device.get(), semaphore, &value) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to read timeline semaphore");
+	}
+	return update_completed(value);
+}
+
+bool TimelineSemaphore::is_complete(uint64_t value) {
+	if (value <= completed_value) return true;
+	return value <= get_value();
+}
+
+/**
+ * Returns false if the timeout ran out first
+ */
+bool TimelineSemaphore::wait(uint64_t value, uint64_t timeout) {
+	if (value <= completed_value) return true;
+
+	VkSemaphoreWaitInfo wait_info{};
+	wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	wait_info.semaphoreCount = 1;
+	wait_info.pSemaphores = &semaphore;
+	wait_info.pValues = &value;
+
+	VkResult result = vkWaitSemaphores(device.get(), &wait_info, timeout);
+	if (result == VK_TIMEOUT) return false;
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to wait on timeline semaphore");
+	}
+
+	update_completed(value);
+	return true;
+}
+
+void TimelineSemaphore::signal(uint64_t value) {
+	VkSemaphoreSignalInfo signal_info{};
+	signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+	signal_info.semaphore = semaphore;
+	signal_info.value = value;
+
+	if (vkSignalSemaphore(device.get(), &signal_info) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to signal timeline semaphore");
+	}
+	update_completed(value);
+}
+
+/**
+ * Raises completed_value to value unless another thread has already raised it further. Returns the result
+ */
+uint64_t TimelineSemaphore::update_completed(uint64_t value) {
+	uint64_t completed = completed_value.load();
+	while (completed < value && !completed_value.compare_exchange_weak(completed, value)) {}
+	return std::max(completed, value);
+}
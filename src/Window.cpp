@@ -4,9 +4,10 @@
 
 #include "Logger.h"
 
-Window::Window(std::string name, int width, int height, bool resizable) {
+Window::Window(std::string name, int width, int height, bool resizable, bool visible) {
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 	window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
 }
 